@@ -0,0 +1,205 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+namespace KalaData
+{
+	using std::vector;
+
+	inline uint64_t ReadBigEndian64(const uint8_t* p)
+	{
+		uint64_t value = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			value = (value << 8) | p[i];
+		}
+
+		return value;
+	}
+
+	inline void WriteBigEndian64(
+		uint8_t* p,
+		uint64_t value)
+	{
+		for (int i = 7; i >= 0; i--)
+		{
+			p[i] = static_cast<uint8_t>(value);
+			value >>= 8;
+		}
+	}
+
+	//Writes value in 7-bit groups, low group first
+	inline void WriteVarint(
+		vector<uint8_t>& output,
+		uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			output.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		output.push_back(static_cast<uint8_t>(value));
+	}
+
+	//Reads a varint at pos and advances past it, false if it runs past size
+	inline bool ReadVarint(
+		const uint8_t* data,
+		size_t size,
+		size_t& pos,
+		uint64_t& value)
+	{
+		value = 0;
+		for (uint32_t shift = 0; shift < 64; shift += 7)
+		{
+			if (pos >= size) return false;
+
+			uint8_t byte = data[pos++];
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+			if ((byte & 0x80) == 0) return true;
+		}
+
+		return false;
+	}
+
+	//Reads bits most significant first, a refill tops the buffer up to 56-63 bits
+	struct BitReader
+	{
+		const uint8_t* data;
+		size_t size;
+		size_t pos;
+		uint64_t bitBuffer = 0;
+		uint32_t bitCount = 0;
+
+		void Refill()
+		{
+			if (pos + 8 <= size)
+			{
+				//bits already in the buffer are reloaded with the same values,
+				//so only the whole bytes that fit are counted as read
+				bitBuffer |= ReadBigEndian64(data + pos) >> bitCount;
+				pos += (63 - bitCount) >> 3;
+				bitCount |= 56;
+				return;
+			}
+
+			while (bitCount <= 56)
+			{
+				uint64_t byte = pos < size ? data[pos] : 0;
+				bitBuffer |= byte << (56 - bitCount);
+				pos++;
+				bitCount += 8;
+			}
+		}
+
+		//Next 1 to 32 bits without consuming them
+		uint32_t Peek(uint32_t bits) const
+		{
+			return static_cast<uint32_t>(bitBuffer >> (64 - bits));
+		}
+
+		void Consume(uint32_t bits)
+		{
+			bitBuffer <<= bits;
+			bitCount -= bits;
+		}
+
+		//Reads 0 to 32 bits
+		uint32_t Read(uint32_t bits)
+		{
+			uint32_t value = static_cast<uint32_t>((bitBuffer >> 1) >> (63 - bits));
+			Consume(bits);
+			return value;
+		}
+
+		//Bits used since start, including any zero padding past the end
+		size_t Consumed(size_t start) const
+		{
+			return (pos - start) * 8 - bitCount;
+		}
+	};
+
+	//Writes bits most significant first into a pre-sized buffer,
+	//whole bytes are flushed from a 64-bit accumulator
+	struct BitWriter
+	{
+		uint8_t* dst;
+		uint64_t bitBuffer = 0;
+		uint32_t bitCount = 0;
+
+		//Up to 57 bits may be added between flushes
+		void Put(
+			uint32_t code,
+			uint32_t bits)
+		{
+			bitBuffer |= static_cast<uint64_t>(code) << (64 - bitCount - bits);
+			bitCount += bits;
+		}
+
+		//Stores the whole buffer but only advances past complete bytes,
+		//the partial byte is rewritten by the next flush
+		void Flush()
+		{
+			WriteBigEndian64(dst, bitBuffer);
+
+			uint32_t bytes = bitCount >> 3;
+			dst += bytes;
+			bitBuffer <<= bytes * 8;
+			bitCount &= 7;
+		}
+	};
+
+	//Builds a bitstream back to front for coders that emit their bits in
+	//reverse decode order. Every Put lands in front of the bits put before it,
+	//so a BitReader reads the last Put first. The buffer needs 8 spare bytes
+	//in front of the data because every flush stores a whole word.
+	struct ReverseBitWriter
+	{
+		uint8_t* dst;
+		uint64_t bitBuffer = 0;
+		uint32_t bitCount = 0;
+
+		//Up to 57 bits may be added between flushes
+		void Put(
+			uint32_t value,
+			uint32_t bits)
+		{
+			bitBuffer |= static_cast<uint64_t>(value) << bitCount;
+			bitCount += bits;
+		}
+
+		void Flush()
+		{
+			WriteBigEndian64(dst - 8, bitBuffer);
+
+			uint32_t bytes = bitCount >> 3;
+			dst -= bytes;
+			bitBuffer >>= bytes * 8;
+			bitCount &= 7;
+		}
+
+		//Puts a 1 marker bit in front of everything and flushes the partial
+		//first byte, the reader skips the zero padding up to and including the marker.
+		//Returns the start of the stream
+		uint8_t* Finish()
+		{
+			Put(1, 1);
+			Flush();
+
+			if (bitCount > 0)
+			{
+				*--dst = static_cast<uint8_t>(bitBuffer);
+				bitBuffer = 0;
+				bitCount = 0;
+			}
+
+			return dst;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace KalaData
+{
+	using std::vector;
+	using std::string;
+
+	//decoded blocks are followed by this many readable bytes,
+	//so consumers may copy symbols in whole chunks
+	constexpr size_t BLOCK_READER_SLACK = 16;
+
+	//How a single stream is stored
+	enum class StreamCoder : uint8_t
+	{
+		STREAM_RAW     = 0,
+		STREAM_HUFFMAN = 1,
+		STREAM_FSE     = 2
+	};
+
+	//Hands out the symbols of a Huffman or FSE coded stream one decoded block
+	//at a time, so decoders run straight off the coded data and never hold
+	//more than one decoded block of it. Raw streams are read in place.
+	//The symbols not read yet are [next, end), [next, limit) may be read
+	class BlockReader
+	{
+	public:
+		const uint8_t* next = nullptr;
+		const uint8_t* end = nullptr;
+		const uint8_t* limit = nullptr;
+
+		BlockReader(
+			StreamCoder coder,
+			const uint8_t* data,
+			size_t size,
+			const string& origin,
+			string& outError);
+
+		//Decodes the next non-empty block, false at the end of
+		//the stream or if the block is damaged, which also sets the error it was given
+		bool Refill();
+
+		//Reads the next symbol, false if the stream has no more
+		bool Read(uint8_t& out)
+		{
+			if (next == end
+				&& !Refill())
+			{
+				return false;
+			}
+
+			out = *next++;
+			return true;
+		}
+
+		//True once every symbol of the stream is read
+		bool IsFinished() const { return next == end && pos == size; }
+	private:
+		StreamCoder coder;
+		const uint8_t* data;
+		size_t size;
+		size_t pos = 0;
+		string origin;
+		string& error;
+
+		vector<uint8_t> block{};
+	};
+}
\ No newline at end of file
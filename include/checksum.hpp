@@ -0,0 +1,32 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace KalaData
+{
+	//CRC-32 (IEEE 802.3, the one zip and png use) of every archived file,
+	//checked after a file is decoded. Eight table lookups per 8 bytes keep it
+	//far ahead of the decoders
+	class Checksum
+	{
+	public:
+		//Continues crc over size bytes of data, start with 0
+		static uint32_t Crc32(
+			const uint8_t* data,
+			size_t size,
+			uint32_t crc = 0);
+
+		//CRC-32 of two joined buffers from the CRC-32 of each one and the size of the second,
+		//so parts checked on different threads give the checksum of the whole file
+		static uint32_t Combine(
+			uint32_t crcA,
+			uint32_t crcB,
+			uint64_t sizeB);
+	};
+}
\ No newline at end of file
@@ -61,6 +61,29 @@ namespace KalaData
 		//Toggles compression verbose messages on and off
 		static void Command_ToggleCompressionVerbosity();
 
+		//Toggles solid compression on and off
+		static void Command_ToggleSolidMode();
+
+		//Set the size of the blocks large files are split into in MB
+		static void Command_SetFileBlockSize(const string& megabytes);
+
+		//Toggles linked blocks of large files on and off
+		static void Command_ToggleLinkedBlocks();
+
+		//Set long-distance matcher memory in MB, 0 turns it off
+		static void Command_SetLongMatchMemory(const string& megabytes);
+
+		//Set how many files compression and decompression work on at the same time, 0 is one per hardware thread
+		static void Command_SetThreadCount(const string& count);
+
+		//Set the trained dictionary used by compression, 'none' clears it
+		static void Command_SetDictionary(const string& target);
+
+		//Dictionary training pre-checks
+		static void Command_Train(
+			const string& origin,
+			const string& target);
+
 		//Compression pre-checks
 		static void Command_Compress(
 			const string& origin,
@@ -71,6 +94,15 @@ namespace KalaData
 			const string& origin,
 			const string& target);
 
+		//Single file extraction pre-checks
+		static void Command_Extract(
+			const string& origin,
+			const string& entryPath,
+			const string& target);
+
+		//Archive contents pre-checks
+		static void Command_Contents(const string& origin);
+
 		//Shuts down KalaData
 		static void Command_Exit();
 	private:
@@ -3,25 +3,107 @@
 //This is free software, and you are welcome to redistribute it under certain conditions.
 //Read LICENSE.md for more information.
 
+#pragma once
+
 #include <string>
 #include <algorithm>
 
+#include "matchfinder.hpp"
+#include "threadpool.hpp"
+
 namespace KalaData
 {
 	using std::string;
 	using std::clamp;
+	using std::min;
+
+	enum class ParserType
+	{
+		PARSER_LAZY,   //greedy or lazy matching, see lazy depth
+		PARSER_OPTIMAL //price-based parse over blocks of candidate matches
+	};
+
+	enum class EntropyCoderType
+	{
+		ENTROPY_TABLE, //Huffman or FSE, whichever stores the file smaller
+		ENTROPY_RANGE  //context-modelled adaptive binary range coder
+	};
 
 	constexpr size_t WINDOW_SIZE_FASTEST  = static_cast<size_t>(4 * 1024);        //4KB
 	constexpr size_t WINDOW_SIZE_FAST     = static_cast<size_t>(32 * 1024);       //32KB
 	constexpr size_t WINDOW_SIZE_BALANCED = static_cast<size_t>(256 * 1024);      //256KB
 	constexpr size_t WINDOW_SIZE_SLOW     = static_cast<size_t>(1 * 1024) * 1024; //1MB
 	constexpr size_t WINDOW_SIZE_ARCHIVE  = static_cast<size_t>(8 * 1024) * 1024; //8MB
+	constexpr size_t WINDOW_SIZE_ULTRA    = static_cast<size_t>(8 * 1024) * 1024; //8MB
 
 	constexpr size_t LOOKAHEAD_FASTEST  = 18;
 	constexpr size_t LOOKAHEAD_FAST     = 32;
 	constexpr size_t LOOKAHEAD_BALANCED = 64;
 	constexpr size_t LOOKAHEAD_SLOW     = 128;
 	constexpr size_t LOOKAHEAD_ARCHIVE  = 255;
+	constexpr size_t LOOKAHEAD_ULTRA    = 255;
+
+	constexpr size_t MAX_CHAIN_FASTEST  = 4;
+	constexpr size_t MAX_CHAIN_FAST     = 16;
+	constexpr size_t MAX_CHAIN_BALANCED = 48;
+	constexpr size_t MAX_CHAIN_SLOW     = 32;
+	constexpr size_t MAX_CHAIN_ARCHIVE  = 64;
+	constexpr size_t MAX_CHAIN_ULTRA    = 128;
+
+	constexpr MatchFinderType MATCH_FINDER_FASTEST  = MatchFinderType::MATCHFINDER_HASH_CHAIN;
+	constexpr MatchFinderType MATCH_FINDER_FAST     = MatchFinderType::MATCHFINDER_HASH_CHAIN;
+	constexpr MatchFinderType MATCH_FINDER_BALANCED = MatchFinderType::MATCHFINDER_HASH_CHAIN;
+	constexpr MatchFinderType MATCH_FINDER_SLOW     = MatchFinderType::MATCHFINDER_BINARY_TREE;
+	constexpr MatchFinderType MATCH_FINDER_ARCHIVE  = MatchFinderType::MATCHFINDER_BINARY_TREE;
+	constexpr MatchFinderType MATCH_FINDER_ULTRA    = MatchFinderType::MATCHFINDER_BINARY_TREE;
+
+	constexpr size_t LAZY_DEPTH_FASTEST  = 0;
+	constexpr size_t LAZY_DEPTH_FAST     = 1;
+	constexpr size_t LAZY_DEPTH_BALANCED = 1;
+	constexpr size_t LAZY_DEPTH_SLOW     = 2;
+	constexpr size_t LAZY_DEPTH_ARCHIVE  = 2;
+	constexpr size_t LAZY_DEPTH_ULTRA    = 2;
+
+	constexpr ParserType PARSER_FASTEST  = ParserType::PARSER_LAZY;
+	constexpr ParserType PARSER_FAST     = ParserType::PARSER_LAZY;
+	constexpr ParserType PARSER_BALANCED = ParserType::PARSER_LAZY;
+	constexpr ParserType PARSER_SLOW     = ParserType::PARSER_LAZY;
+	constexpr ParserType PARSER_ARCHIVE  = ParserType::PARSER_OPTIMAL;
+	constexpr ParserType PARSER_ULTRA    = ParserType::PARSER_OPTIMAL;
+
+	constexpr EntropyCoderType ENTROPY_CODER_FASTEST  = EntropyCoderType::ENTROPY_TABLE;
+	constexpr EntropyCoderType ENTROPY_CODER_FAST     = EntropyCoderType::ENTROPY_TABLE;
+	constexpr EntropyCoderType ENTROPY_CODER_BALANCED = EntropyCoderType::ENTROPY_TABLE;
+	constexpr EntropyCoderType ENTROPY_CODER_SLOW     = EntropyCoderType::ENTROPY_TABLE;
+	constexpr EntropyCoderType ENTROPY_CODER_ARCHIVE  = EntropyCoderType::ENTROPY_TABLE;
+	constexpr EntropyCoderType ENTROPY_CODER_ULTRA    = EntropyCoderType::ENTROPY_RANGE;
+
+	constexpr size_t MIN_MATCH = 3;
+
+	//matches that reach the lookahead are extended up to this length
+	constexpr size_t MAX_MATCH = static_cast<size_t>(64 * 1024);
+
+	//solid mode packs files into blocks of up to this many bytes
+	constexpr size_t SOLID_BLOCK_SIZE = static_cast<size_t>(16 * 1024) * 1024; //16MB
+
+	//files this large have enough data of their own and are compressed alone even in solid mode
+	constexpr size_t SOLID_MAX_FILE_SIZE = static_cast<size_t>(1 * 1024) * 1024; //1MB
+
+	//solid mode samples up to this many bytes of every small file and leaves files
+	//that look already compressed out of its blocks
+	constexpr size_t SOLID_PROBE_SIZE = static_cast<size_t>(64 * 1024); //64KB
+
+	//files larger than this are split into blocks of this size by default,
+	//each block is compressed and decompressed on its own thread
+	constexpr size_t FILE_BLOCK_SIZE_DEFAULT = static_cast<size_t>(8 * 1024) * 1024; //8MB
+
+	//no file is held in memory in one piece if it is larger than the block size,
+	//so the block size range bounds the memory of compression and decompression
+	constexpr size_t FILE_BLOCK_SIZE_MIN = static_cast<size_t>(1 * 1024) * 1024;  //1MB
+	constexpr size_t FILE_BLOCK_SIZE_MAX = static_cast<size_t>(64 * 1024) * 1024; //64MB
+
+	//largest hash table of the long-distance matcher
+	constexpr size_t LONG_MATCH_MEMORY_MAX = static_cast<size_t>(1024 * 1024) * 1024; //1GB
 
 	class Compress
 	{
@@ -55,6 +137,109 @@ namespace KalaData
 		};
 		static size_t GetLookAhead() { return LOOKAHEAD; }
 
+		//Assign a new max search depth value,
+		//hash chain entries or binary tree nodes visited per position.
+		//Supported range 4-128
+		static void SetMaxChain(size_t maxChainValue)
+		{
+			MAX_CHAIN = clamp(
+				maxChainValue,
+				MAX_CHAIN_FASTEST,
+				MAX_CHAIN_ULTRA);
+		};
+		static size_t GetMaxChain() { return MAX_CHAIN; }
+
+		//Assign the match finder used by CompressBuffer
+		static void SetMatchFinder(MatchFinderType matchFinderValue) { MATCH_FINDER = matchFinderValue; }
+		static MatchFinderType GetMatchFinder() { return MATCH_FINDER; }
+
+		//Assign how many bytes past a match the parser peeks for a longer one,
+		//0 is greedy. Supported range 0-2
+		static void SetLazyDepth(size_t lazyDepthValue)
+		{
+			LAZY_DEPTH = clamp(
+				lazyDepthValue,
+				LAZY_DEPTH_FASTEST,
+				LAZY_DEPTH_ARCHIVE);
+		};
+		static size_t GetLazyDepth() { return LAZY_DEPTH; }
+
+		//Assign the parser that turns matches into tokens
+		static void SetParser(ParserType parserValue) { PARSER = parserValue; }
+		static ParserType GetParser() { return PARSER; }
+
+		//Assign the entropy coder that stores the LZSS tokens
+		static void SetEntropyCoder(EntropyCoderType entropyCoderValue) { ENTROPY_CODER = entropyCoderValue; }
+		static EntropyCoderType GetEntropyCoder() { return ENTROPY_CODER; }
+
+		//Names of the match finder, parser and entropy coder as the commands and verbose logs print them
+		static string MatchFinderName(MatchFinderType type)
+		{
+			return type == MatchFinderType::MATCHFINDER_BINARY_TREE
+				? "binary tree"
+				: "hash chain";
+		}
+		static string ParserName(ParserType type)
+		{
+			return type == ParserType::PARSER_OPTIMAL
+				? "optimal"
+				: "lazy";
+		}
+		static string EntropyCoderName(EntropyCoderType type)
+		{
+			return type == EntropyCoderType::ENTROPY_RANGE
+				? "range coder"
+				: "huffman or fse";
+		}
+
+		//Toggle solid compression, consecutive files share one compressed block
+		//so small similar files can match against each other
+		static void SetSolidModeState(bool newState) { SOLID_MODE = newState; }
+		static bool IsSolidModeEnabled() { return SOLID_MODE; }
+
+		//Assign the size of the blocks large files are split into, no larger piece of a file
+		//is ever held in memory. Supported range 1MB-64MB
+		static void SetFileBlockSize(size_t blockSizeValue)
+		{
+			FILE_BLOCK_SIZE = clamp(
+				blockSizeValue,
+				FILE_BLOCK_SIZE_MIN,
+				FILE_BLOCK_SIZE_MAX);
+		};
+		static size_t GetFileBlockSize() { return FILE_BLOCK_SIZE; }
+
+		//Toggle linked blocks, every block of a large file matches into the end of the block before it.
+		//Smaller archives, but the blocks of one file decompress one after another
+		static void SetLinkedBlocksState(bool newState) { LINKED_BLOCKS = newState; }
+		static bool IsLinkedBlocksEnabled() { return LINKED_BLOCKS; }
+
+		//Assign the memory of the long-distance matcher in bytes, 0 turns it off.
+		//It finds repeats beyond the window, independent of the window size.
+		//Supported range 0-1GB
+		static void SetLongMatchMemory(size_t memoryValue)
+		{
+			LONG_MATCH_MEMORY = min(
+				memoryValue,
+				LONG_MATCH_MEMORY_MAX);
+		};
+		static size_t GetLongMatchMemory() { return LONG_MATCH_MEMORY; }
+
+		//Assign the dictionary that primes the window of every compressed file,
+		//it is stored once in the archive. Empty turns it off
+		static void SetDictionary(const vector<uint8_t>& dictionaryValue) { DICTIONARY = dictionaryValue; }
+		static const vector<uint8_t>& GetDictionary() { return DICTIONARY; }
+
+		//Assign how many files or solid blocks are compressed or decompressed at the same time,
+		//0 is one per hardware thread. Every thread count writes the same archive.
+		//Supported range 0-256
+		static void SetThreadCount(size_t threadCountValue)
+		{
+			THREAD_COUNT = min(
+				threadCountValue,
+				MAX_THREAD_COUNT);
+		}
+		static size_t GetThreadCount() { return THREAD_COUNT; }
+
 		//Compresses selected folder straight to .kdat archive inside target folder,
 		//skips all safety checks that are handled in the Command class for the Compress command
 		static void CompressToArchive(
@@ -66,11 +251,56 @@ namespace KalaData
 		static void DecompressToFolder(
 			const string& origin,
 			const string& target);
+
+		//Decompresses the single file at entryPath inside selected .kdat archive into selected target folder,
+		//seeks straight to it through the central directory at the end of the archive.
+		//Skips all safety checks that are handled in the Command class for the Extract command
+		static void ExtractFile(
+			const string& origin,
+			const string& entryPath,
+			const string& target);
+
+		//Lists every file inside selected .kdat archive from its central directory without decompressing anything,
+		//skips all safety checks that are handled in the Command class for the Contents command
+		static void ListContents(const string& origin);
 	private:
 		//Sliding window
 		static inline size_t WINDOW_SIZE = WINDOW_SIZE_FASTEST;
 
-		//Max match length
+		//Longest match searched for, matches that reach it are extended up to MAX_MATCH
 		static inline size_t LOOKAHEAD = LOOKAHEAD_FASTEST;
+
+		//How many earlier positions the match finder checks per byte
+		static inline size_t MAX_CHAIN = MAX_CHAIN_FASTEST;
+
+		//Hash chain for small windows, binary tree for the largest ones
+		static inline MatchFinderType MATCH_FINDER = MATCH_FINDER_FASTEST;
+
+		//Lookahead steps before committing to a match
+		static inline size_t LAZY_DEPTH = LAZY_DEPTH_FASTEST;
+
+		//Lazy matching or optimal parsing
+		static inline ParserType PARSER = PARSER_FASTEST;
+
+		//Table coders for speed, range coder for the smallest archives
+		static inline EntropyCoderType ENTROPY_CODER = ENTROPY_CODER_FASTEST;
+
+		//One block per file, or files packed into SOLID_BLOCK_SIZE blocks
+		static inline bool SOLID_MODE = false;
+
+		//Files larger than this are split into blocks of this size
+		static inline size_t FILE_BLOCK_SIZE = FILE_BLOCK_SIZE_DEFAULT;
+
+		//Independent blocks, or blocks that start with the end of the previous block as history
+		static inline bool LINKED_BLOCKS = false;
+
+		//Hash table bytes of the long-distance matcher, 0 is off
+		static inline size_t LONG_MATCH_MEMORY = 0;
+
+		//Trained data every file can match against, empty is off
+		static inline vector<uint8_t> DICTIONARY{};
+
+		//Compression and decompression worker threads, 0 is one per hardware thread
+		static inline size_t THREAD_COUNT = 1;
 	};
 }
\ No newline at end of file
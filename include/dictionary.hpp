@@ -0,0 +1,51 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace KalaData
+{
+	using std::vector;
+	using std::string;
+
+	//size of a trained dictionary
+	constexpr size_t DICTIONARY_SIZE = static_cast<size_t>(112 * 1024);
+
+	//largest dictionary that is loaded or accepted from an archive, the largest window
+	constexpr size_t DICTIONARY_MAX_SIZE = static_cast<size_t>(8 * 1024) * 1024;
+
+	//training reads at most this many sample bytes
+	constexpr size_t DICTIONARY_MAX_SAMPLES = static_cast<size_t>(128 * 1024) * 1024;
+
+	//Builds dictionaries that prime the LZSS window for small, similar files.
+	//Training splits the samples into one epoch per dictionary segment and takes
+	//the segment of each epoch whose 8-byte substrings appear in the most samples,
+	//substrings already in the dictionary no longer count (in the style of COVER).
+	class Dictionary
+	{
+	public:
+		//Trains a dictionary from the files in the origin folder and writes it to the target .kdict file,
+		//skips all safety checks that are handled in the Command class for the Train command
+		static void TrainToFile(
+			const string& origin,
+			const string& target);
+
+		//Reads a .kdict file written by TrainToFile, returns false if it is not a valid dictionary
+		static bool Load(
+			const string& origin,
+			vector<uint8_t>& out);
+
+		//Picks up to dictionarySize bytes of samples, the most useful segments go last
+		//so they are the closest to the data. sampleSizes splits samples into files
+		static vector<uint8_t> Train(
+			const vector<uint8_t>& samples,
+			const vector<size_t>& sampleSizes,
+			size_t dictionarySize);
+	};
+}
\ No newline at end of file
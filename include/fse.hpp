@@ -0,0 +1,46 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace KalaData
+{
+	using std::vector;
+	using std::string;
+
+	//state tables have between 2^5 and 2^11 entries
+	constexpr uint32_t FSE_MIN_TABLE_LOG = 5;
+	constexpr uint32_t FSE_MAX_TABLE_LOG = 11;
+
+	//symbols per FSE block, each block has its own normalized counts
+	constexpr size_t FSE_BLOCK_SIZE = static_cast<size_t>(128 * 1024);
+
+	//Table-based asymmetric numeral system coder (tANS, FSE-style) for the
+	//LZSS token stream. Symbols cost fractional bits, so skewed distributions
+	//such as the token flag bytes code tighter than with Huffman codes.
+	class Fse
+	{
+	public:
+		//Post-LZSS filter
+		static vector<uint8_t> Encode(
+			const vector<uint8_t>& input,
+			const string& origin);
+
+		//Decodes the block at pos of data written by Encode into out and moves pos
+		//past it, so a stream can be consumed one block at a time.
+		//A damaged block returns false with the reason in outError
+		static bool DecodeNextBlock(
+			const uint8_t* data,
+			size_t size,
+			size_t& pos,
+			vector<uint8_t>& out,
+			const string& origin,
+			string& outError);
+	};
+}
\ No newline at end of file
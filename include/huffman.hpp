@@ -0,0 +1,55 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace KalaData
+{
+	using std::vector;
+	using std::string;
+
+	//longest code, small enough that the decoder resolves every code with
+	//one probe of a 4096-entry table. Lengths are stored as 4-bit values
+	constexpr uint32_t HUFFMAN_MAX_CODE_LENGTH = 12;
+
+	//symbols per entropy block before neighbouring blocks are merged
+	constexpr size_t HUFFMAN_BLOCK_SIZE = static_cast<size_t>(128 * 1024);
+
+	//blocks of at least this many symbols are split into four bitstreams
+	constexpr size_t HUFFMAN_FOUR_STREAM_MIN = static_cast<size_t>(4 * 1024);
+
+	//Canonical Huffman coder for the LZSS token stream. The input is coded in
+	//size-prefixed blocks, each starting with its symbol count and the 4-bit code
+	//length of every symbol, the codes are rebuilt from the lengths on both sides.
+	class Huffman
+	{
+	public:
+		//Computes code lengths no longer than maxLength for freq, unused symbols get 0
+		static void BuildCodeLengths(
+			const size_t freq[256],
+			uint8_t lengths[256],
+			uint32_t maxLength = HUFFMAN_MAX_CODE_LENGTH);
+
+		//Post-LZSS filter
+		static vector<uint8_t> Encode(
+			const vector<uint8_t>& input,
+			const string& origin);
+
+		//Decodes the block at pos of data written by Encode into out and moves pos
+		//past it, so a stream can be consumed one block at a time.
+		//A damaged block returns false with the reason in outError
+		static bool DecodeNextBlock(
+			const uint8_t* data,
+			size_t size,
+			size_t& pos,
+			vector<uint8_t>& out,
+			const string& origin,
+			string& outError);
+	};
+}
\ No newline at end of file
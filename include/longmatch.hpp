@@ -0,0 +1,42 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+namespace KalaData
+{
+	using std::vector;
+
+	//shortest repeat the long-distance matcher finds, also the length its rolling hash covers
+	constexpr size_t LONG_MATCH_MIN = 64;
+
+	//positions are sampled at least every 2^LONG_MATCH_MIN_STRIDE_LOG bytes on average
+	constexpr uint32_t LONG_MATCH_MIN_STRIDE_LOG = 4;
+
+	struct LongMatch
+	{
+		size_t pos;
+		size_t offset;
+		size_t length;
+	};
+
+	//Finds repeats far beyond the sliding window. A rolling hash over LONG_MATCH_MIN bytes
+	//samples positions by content, on average once per stride, into a fixed-size table, so the
+	//same data is sampled at the same spots wherever it repeats. The stride grows with
+	//the input so the table still spans all of it, memory never exceeds the chosen budget.
+	class LongMatchFinder
+	{
+	public:
+		//Returns the repeats of at least LONG_MATCH_MIN bytes further back than windowSize,
+		//sorted by position and not overlapping, using at most memory bytes of tables
+		static vector<LongMatch> Find(
+			const vector<uint8_t>& input,
+			size_t windowSize,
+			size_t memory);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,248 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+#endif
+
+namespace KalaData
+{
+	using std::vector;
+	using std::unique_ptr;
+	using std::memcpy;
+	using std::countr_zero;
+	using std::countl_zero;
+	using std::endian;
+
+	enum class MatchFinderType
+	{
+		MATCHFINDER_HASH_CHAIN,
+		MATCHFINDER_BINARY_TREE
+	};
+
+	struct Match
+	{
+		size_t length;
+		size_t offset;
+	};
+
+	//Shared interface of all match finders. Every position of the input
+	//must be passed to either FindMatches or Skip exactly once, in order.
+	class MatchFinder
+	{
+	public:
+		virtual ~MatchFinder() = default;
+
+		//Creates the match finder of the chosen type over input
+		static unique_ptr<MatchFinder> Create(
+			MatchFinderType type,
+			const vector<uint8_t>& input,
+			size_t windowSize,
+			size_t lookAhead,
+			size_t maxDepth);
+
+		//Collects the matches at pos into matches, each one strictly longer than
+		//the one before it, then adds pos to the finder. Returns the longest length or 0.
+		virtual size_t FindMatches(
+			size_t pos,
+			vector<Match>& matches) = 0;
+
+		//Adds pos to the finder without reporting matches
+		virtual void Skip(size_t pos) = 0;
+
+		//Copies this finder over input, which must start with the bytes already added to it,
+		//the copy continues at the next position
+		virtual unique_ptr<MatchFinder> Clone(const vector<uint8_t>& input) const = 0;
+
+		//Returns the longest match length at pos (0 if shorter than MIN_MATCH),
+		//writes its distance to outOffset and adds pos to the finder
+		size_t FindMatch(
+			size_t pos,
+			size_t& outOffset);
+
+		//Counts how many bytes match between a and b, up to limit.
+		//Both pointers must be readable for limit bytes
+		static size_t MatchLength(
+			const uint8_t* a,
+			const uint8_t* b,
+			size_t limit);
+	private:
+		vector<Match> scratch{};
+	};
+
+	//Walks a chain of previous positions that share the same 3-byte hash, newest first
+	class HashChain : public MatchFinder
+	{
+	public:
+		HashChain(
+			const vector<uint8_t>& input,
+			size_t windowSize,
+			size_t lookAhead,
+			size_t maxChain);
+
+		size_t FindMatches(
+			size_t pos,
+			vector<Match>& matches) override;
+
+		void Skip(size_t pos) override;
+
+		unique_ptr<MatchFinder> Clone(const vector<uint8_t>& input) const override;
+	private:
+		const uint8_t* data;
+		size_t size;
+		size_t windowSize;
+		size_t lookAhead;
+		size_t maxChain;
+
+		uint32_t hashShift;
+		size_t prevMask;
+
+		//newest position per hash
+		vector<uint32_t> head;
+		//previous position with the same hash, indexed by position & prevMask
+		vector<uint32_t> prev;
+
+		uint32_t Hash(size_t pos) const;
+	};
+
+	//Keeps every position of the window in binary search trees sorted by
+	//the bytes that follow it, one tree per 4-byte hash (BT4). Each lookup
+	//walks a single root-to-leaf path and re-roots the tree at the new position,
+	//so long repetitive runs cost logarithmic time instead of a full chain walk.
+	//Memory is 8 bytes per window byte plus the hash heads.
+	class BinaryTree : public MatchFinder
+	{
+	public:
+		BinaryTree(
+			const vector<uint8_t>& input,
+			size_t windowSize,
+			size_t lookAhead,
+			size_t maxDepth);
+
+		size_t FindMatches(
+			size_t pos,
+			vector<Match>& matches) override;
+
+		void Skip(size_t pos) override;
+
+		unique_ptr<MatchFinder> Clone(const vector<uint8_t>& input) const override;
+	private:
+		const uint8_t* data;
+		size_t size;
+		size_t windowSize;
+		size_t lookAhead;
+		size_t maxDepth;
+
+		uint32_t hashShift;
+
+		//all stored positions are relative to base so they fit in 32 bits
+		size_t base = 0;
+		size_t cyclicPos = 0;
+		size_t cyclicSize;
+
+		//newest position per 3-byte hash, catches matches the 4-byte trees can't
+		vector<uint32_t> head3;
+		//tree root per 4-byte hash
+		vector<uint32_t> head4;
+		//left and right child of every position in the window
+		vector<uint32_t> son;
+
+		size_t Search(
+			size_t pos,
+			vector<Match>* matches);
+
+		void Advance(size_t pos);
+
+		//Rebases stored positions before they overflow 32 bits
+		void Normalize(size_t pos);
+	};
+
+	//Most matches end within their first few bytes, so the first 8 bytes are compared as
+	//one integer. Longer matches continue 32 bytes at a time with AVX2 and 16 with SSE2
+	//when the compiler targets them, then 8 at a time. The first mismatch is the lowest
+	//set bit of the mismatch mask or of the XOR of both words, no byte is compared twice
+	inline size_t MatchFinder::MatchLength(
+		const uint8_t* a,
+		const uint8_t* b,
+		size_t limit)
+	{
+		size_t length = 0;
+
+		auto CompareWord = [a, b](size_t at, size_t& outLength)
+			{
+				uint64_t wordA;
+				uint64_t wordB;
+				memcpy(&wordA, a + at, sizeof(wordA));
+				memcpy(&wordB, b + at, sizeof(wordB));
+
+				uint64_t diff = wordA ^ wordB;
+				if (diff == 0) return false;
+
+				outLength = at + (endian::native == endian::little
+					? countr_zero(diff)
+					: countl_zero(diff)) / 8;
+
+				return true;
+			};
+
+		if (limit >= 8)
+		{
+			if (CompareWord(0, length)) return length;
+			length = 8;
+		}
+
+#if defined(__AVX2__)
+		while (length + 32 <= limit)
+		{
+			__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + length));
+			__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + length));
+			uint32_t equal = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+
+			if (equal != UINT32_MAX) return length + countr_zero(~equal);
+
+			length += 32;
+		}
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		while (length + 16 <= limit)
+		{
+			__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + length));
+			__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + length));
+			uint32_t equal = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)));
+
+			if (equal != 0xFFFF) return length + countr_zero(~equal);
+
+			length += 16;
+		}
+#endif
+
+		while (length + 8 <= limit)
+		{
+			size_t end;
+			if (CompareWord(length, end)) return end;
+
+			length += 8;
+		}
+
+		while (length < limit
+			&& a[length] == b[length])
+		{
+			length++;
+		}
+
+		return length;
+	}
+}
\ No newline at end of file
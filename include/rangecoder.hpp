@@ -0,0 +1,44 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace KalaData
+{
+	using std::vector;
+	using std::string;
+
+	//Context-modelled adaptive binary range coder for LZSS tokens, in the
+	//style of LZMA. Flags, literals, lengths and offsets each have their own
+	//adaptive bit models, literals are predicted from the previous byte and,
+	//right after a match, from the byte at the last match offset.
+	//Much slower to decode than the table coders, meant for cold storage.
+	class RangeCoder
+	{
+	public:
+		//Codes the tokens of lzssStream, input from start is the data they decode to
+		//and the bytes before start are the dictionary they may match into
+		static vector<uint8_t> Encode(
+			const vector<uint8_t>& lzssStream,
+			const vector<uint8_t>& input,
+			size_t start,
+			const string& origin);
+
+		//Decodes straight to the original data, token decoding and match copies happen in one pass.
+		//Matches may reach back into dictionary, which sits right before the data.
+		//Damaged data returns nothing with the reason in outError
+		static vector<uint8_t> Decode(
+			const uint8_t* data,
+			size_t size,
+			size_t originalSize,
+			const vector<uint8_t>& dictionary,
+			const string& origin,
+			string& outError);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace KalaData
+{
+	using std::vector;
+	using std::deque;
+	using std::unique_ptr;
+	using std::function;
+	using std::thread;
+	using std::mutex;
+	using std::condition_variable;
+	using std::atomic;
+
+	//most worker threads a pool may start
+	constexpr size_t MAX_THREAD_COUNT = 256;
+
+	//Fixed set of worker threads with one task queue each. Workers run their own queue
+	//oldest task first and steal the oldest task of another queue once theirs is empty,
+	//so tasks submitted by a task stay on the thread that holds their data until
+	//another thread runs out of work. Tasks run roughly in submission order,
+	//which keeps in-order consumers of their results from waiting long
+	class ThreadPool
+	{
+	public:
+		//Starts threadCount workers, clamped to 1-MAX_THREAD_COUNT
+		ThreadPool(size_t threadCount);
+
+		//Runs every task that is still queued, then joins the workers
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		//Queues task, workers put it in their own queue, other threads spread tasks over all queues
+		void Submit(function<void()> task);
+
+		size_t GetThreadCount() const { return workers.size(); }
+
+		//Index of the worker running the calling task, from 0 to the thread count,
+		//SIZE_MAX on threads that are not workers of this pool
+		size_t GetWorkerIndex() const;
+
+		//Worker threads for a thread count setting, 0 is one per hardware thread
+		static size_t ResolveThreadCount(size_t threadCount);
+	private:
+		struct TaskQueue
+		{
+			mutex lock;
+			deque<function<void()>> tasks;
+		};
+
+		vector<unique_ptr<TaskQueue>> queues{};
+		vector<thread> workers{};
+
+		//submitted tasks no worker has taken yet, sleeping workers wait for it to rise
+		atomic<size_t> pending{};
+		atomic<size_t> nextQueue{};
+
+		mutex sleepLock{};
+		condition_variable wake{};
+		bool stopping = false;
+
+		void WorkerLoop(size_t index);
+
+		//Takes the oldest task of queue index, or steals the oldest one of another queue
+		bool TakeTask(
+			size_t index,
+			function<void()>& outTask);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,314 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+
+#include "compress.hpp"
+
+namespace KalaData
+{
+	using std::vector;
+	using std::string;
+	using std::memcpy;
+
+	//decoders allocate this many bytes past the end of their output,
+	//so literal runs and matches may copy in whole chunks
+	constexpr size_t WILDCOPY_OVERLENGTH = 32;
+
+	//offset slots cover every 32-bit distance, the slot stream
+	//codes a repeat offset as OFFSET_SLOT_COUNT + its history index
+	constexpr uint32_t OFFSET_SLOT_COUNT = 64;
+
+	//recent match offsets the coders keep, a match at one of them is coded by its index
+	constexpr uint32_t REP_COUNT = 4;
+
+	//Most recent distinct match offsets, newest first. Parser and coders update
+	//their own copy after every match so they always agree on the indices
+	struct RepHistory
+	{
+		uint32_t offsets[REP_COUNT]{};
+
+		//Index of offset in the history, REP_COUNT if it isn't there
+		uint32_t Find(uint32_t offset) const
+		{
+			for (uint32_t i = 0; i < REP_COUNT; i++)
+			{
+				if (offsets[i] == offset) return i;
+			}
+
+			return REP_COUNT;
+		}
+
+		//Moves the offset at index to the front
+		void Use(uint32_t index)
+		{
+			uint32_t offset = offsets[index];
+			for (uint32_t i = index; i > 0; i--)
+			{
+				offsets[i] = offsets[i - 1];
+			}
+			offsets[0] = offset;
+		}
+
+		//Adds a new offset to the front, the oldest one drops out
+		void Push(uint32_t offset)
+		{
+			for (uint32_t i = REP_COUNT - 1; i > 0; i--)
+			{
+				offsets[i] = offsets[i - 1];
+			}
+			offsets[0] = offset;
+		}
+
+		//Records a match at offset, returns its index before the update or REP_COUNT
+		uint32_t Update(uint32_t offset)
+		{
+			uint32_t index = Find(offset);
+
+			if (index < REP_COUNT) Use(index);
+			else Push(offset);
+
+			return index;
+		}
+	};
+
+	//Offsets are coded as distance = offset - 1, split into a slot (the bit
+	//length of the distance plus the bit below its top bit) and extra bits
+	inline uint32_t OffsetSlot(uint32_t distance)
+	{
+		if (distance < 4) return distance;
+
+		uint32_t topBit = std::bit_width(distance) - 1;
+		return (topBit << 1) | ((distance >> (topBit - 1)) & 1);
+	}
+
+	//Number of extra bits after a slot
+	inline uint32_t OffsetExtraBits(uint32_t slot)
+	{
+		return slot < 4 ? 0 : (slot >> 1) - 1;
+	}
+
+	//Smallest distance of a slot
+	inline uint32_t OffsetBase(uint32_t slot)
+	{
+		return slot < 4 ? slot : (2 | (slot & 1)) << OffsetExtraBits(slot);
+	}
+
+	//Copies a match of length bytes from offset bytes back to dst, writing whole
+	//16-byte chunks when the match is at least 16 bytes back and 8-byte chunks
+	//when it is at least 8 bytes back. Closer matches repeat their pattern of offset
+	//bytes, which is expanded to 8 bytes and written in steps of its largest multiple
+	//that fits in 8. May write up to WILDCOPY_OVERLENGTH bytes past dst + length
+	inline void CopyMatch(
+		uint8_t* dst,
+		size_t offset,
+		size_t length)
+	{
+		const uint8_t* src = dst - offset;
+		uint8_t* last = dst + length;
+
+		if (offset >= 16)
+		{
+			do
+			{
+				memcpy(dst, src, 16);
+				dst += 16;
+				src += 16;
+			} while (dst < last);
+
+			return;
+		}
+
+		if (offset >= 8)
+		{
+			do
+			{
+				memcpy(dst, src, 8);
+				dst += 8;
+				src += 8;
+			} while (dst < last);
+
+			return;
+		}
+
+		uint8_t pattern[8];
+		for (size_t i = 0; i < 8; i++) pattern[i] = src[i % offset];
+
+		size_t step = 8 - 8 % offset;
+		do
+		{
+			memcpy(dst, pattern, 8);
+			dst += step;
+		} while (dst < last);
+	}
+
+	//first byte of the LZSS token format written by CompressBuffer
+	constexpr uint8_t TOKEN_FORMAT_VERSION = 2;
+
+	//match lengths from MIN_MATCH + LENGTH_ESCAPE up store the rest in 16 more bits
+	constexpr uint32_t LENGTH_ESCAPE = 255;
+	constexpr uint32_t LENGTH_ESCAPE_BITS = 16;
+
+	struct Token
+	{
+		bool isLiteral;
+		uint8_t literal;
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	//Bytes a match offset takes in the token format for this window
+	inline uint32_t OffsetBytes(size_t windowSize)
+	{
+		if (windowSize <= (static_cast<size_t>(1) << 16)) return 2;
+		if (windowSize <= (static_cast<size_t>(1) << 24)) return 3;
+		return 4;
+	}
+
+	//Writes the LZSS token format: the version byte and the offset width, then
+	//groups of up to 8 tokens, each led by a flag byte with one bit per token,
+	//lowest bit first and 1 for a literal. A literal is its byte, a match is its
+	//offset in offsetBytes little endian bytes and its length - MIN_MATCH,
+	//LENGTH_ESCAPE and up continue in 2 more bytes
+	struct TokenWriter
+	{
+		vector<uint8_t>& output;
+		uint32_t offsetBytes;
+		size_t flagPos = 0;
+		uint32_t flagCount = 8;
+
+		TokenWriter(
+			vector<uint8_t>& output,
+			size_t windowSize) :
+			output(output),
+			offsetBytes(OffsetBytes(windowSize))
+		{
+			output.push_back(TOKEN_FORMAT_VERSION);
+			output.push_back(static_cast<uint8_t>(offsetBytes));
+		}
+
+		void Flag(bool isLiteral)
+		{
+			if (flagCount == 8)
+			{
+				flagPos = output.size();
+				output.push_back(0);
+				flagCount = 0;
+			}
+
+			if (isLiteral) output[flagPos] |= static_cast<uint8_t>(1u << flagCount);
+			flagCount++;
+		}
+
+		void Literal(uint8_t literal)
+		{
+			Flag(true);
+			output.push_back(literal);
+		}
+
+		void Match(
+			uint32_t offset,
+			size_t length)
+		{
+			Flag(false);
+
+			for (uint32_t i = 0; i < offsetBytes; i++)
+			{
+				output.push_back(static_cast<uint8_t>(offset >> (i * 8)));
+			}
+
+			size_t value = length - MIN_MATCH;
+			if (value < LENGTH_ESCAPE)
+			{
+				output.push_back(static_cast<uint8_t>(value));
+				return;
+			}
+
+			value -= LENGTH_ESCAPE;
+			output.push_back(static_cast<uint8_t>(LENGTH_ESCAPE));
+			output.push_back(static_cast<uint8_t>(value));
+			output.push_back(static_cast<uint8_t>(value >> 8));
+		}
+	};
+
+	//Reads back what TokenWriter wrote, the stream never leaves the process
+	//so it is trusted and only its length is checked
+	struct TokenReader
+	{
+		const vector<uint8_t>& input;
+		size_t pos = 2;
+		uint32_t offsetBytes = input.size() > 1 ? input[1] : 0;
+		uint32_t flags = 0;
+		uint32_t flagCount = 8;
+
+		bool Next(Token& token)
+		{
+			if (pos >= input.size()) return false;
+
+			if (flagCount == 8)
+			{
+				flags = input[pos++];
+				flagCount = 0;
+
+				if (pos >= input.size()) return false;
+			}
+
+			token.isLiteral = ((flags >> flagCount++) & 1) != 0;
+
+			if (token.isLiteral)
+			{
+				token.literal = input[pos++];
+				token.length = 1;
+				return true;
+			}
+
+			token.offset = 0;
+			for (uint32_t i = 0; i < offsetBytes; i++)
+			{
+				token.offset |= static_cast<uint32_t>(input[pos++]) << (i * 8);
+			}
+
+			size_t value = input[pos++];
+			if (value == LENGTH_ESCAPE)
+			{
+				value += input[pos] | (static_cast<size_t>(input[pos + 1]) << 8);
+				pos += 2;
+			}
+
+			token.length = static_cast<uint32_t>(value + MIN_MATCH);
+			return true;
+		}
+	};
+
+	//Splits the LZSS tokens into separate flag, literal, length, offset slot
+	//and offset extra bit streams, offsets still in the RepHistory only get a
+	//rep slot. Every byte stream is entropy coded on its own with Huffman or FSE,
+	//whichever is smallest, or stored raw.
+	class TokenStreams
+	{
+	public:
+		//Splits and codes the tokens of lzssStream
+		static vector<uint8_t> Encode(
+			const vector<uint8_t>& lzssStream,
+			const string& origin);
+
+		//Decodes straight to the original data, the streams are read side by side.
+		//Matches may reach back into dictionary, which sits right before the data.
+		//Damaged data returns nothing with the reason in outError
+		static vector<uint8_t> Decode(
+			const uint8_t* data,
+			size_t size,
+			size_t originalSize,
+			const vector<uint8_t>& dictionary,
+			const string& origin,
+			string& outError);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#include "blockreader.hpp"
+#include "huffman.hpp"
+#include "fse.hpp"
+
+using KalaData::BlockReader;
+using KalaData::StreamCoder;
+using KalaData::Huffman;
+using KalaData::Fse;
+using KalaData::BLOCK_READER_SLACK;
+
+namespace KalaData
+{
+	BlockReader::BlockReader(
+		StreamCoder coder,
+		const uint8_t* data,
+		size_t size,
+		const string& origin,
+		string& outError) :
+		coder(coder),
+		data(data),
+		size(size),
+		origin(origin),
+		error(outError) {}
+
+	bool BlockReader::Refill()
+	{
+		if (coder == StreamCoder::STREAM_RAW)
+		{
+			if (pos == size) return false;
+
+			next = data;
+			end = data + size;
+			limit = end;
+			pos = size;
+
+			return true;
+		}
+
+		while (pos < size)
+		{
+			bool decoded = coder == StreamCoder::STREAM_FSE
+				? Fse::DecodeNextBlock(
+					data,
+					size,
+					pos,
+					block,
+					origin,
+					error)
+				: Huffman::DecodeNextBlock(
+					data,
+					size,
+					pos,
+					block,
+					origin,
+					error);
+
+			if (!decoded) return false;
+
+			size_t count = block.size();
+			if (count == 0) continue;
+
+			block.resize(count + BLOCK_READER_SLACK);
+
+			next = block.data();
+			end = next + count;
+			limit = end + BLOCK_READER_SLACK;
+
+			return true;
+		}
+
+		return false;
+	}
+}
\ No newline at end of file
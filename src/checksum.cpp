@@ -0,0 +1,145 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#include <array>
+
+#include "checksum.hpp"
+
+using KalaData::Checksum;
+
+using std::array;
+
+//reflected form of the CRC-32 polynomial
+constexpr uint32_t CRC32_POLYNOMIAL = 0xEDB88320u;
+
+//Slice-by-8 tables, table k advances a byte that sits k bytes before the end of a word
+static constexpr array<array<uint32_t, 256>, 8> BuildTables()
+{
+	array<array<uint32_t, 256>, 8> tables{};
+
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 1)
+				? (crc >> 1) ^ CRC32_POLYNOMIAL
+				: crc >> 1;
+		}
+		tables[0][i] = crc;
+	}
+
+	for (size_t k = 1; k < 8; k++)
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t previous = tables[k - 1][i];
+			tables[k][i] = (previous >> 8) ^ tables[0][previous & 0xFF];
+		}
+	}
+
+	return tables;
+}
+
+static constexpr array<array<uint32_t, 256>, 8> CRC32_TABLES = BuildTables();
+
+//Product of two polynomials modulo the CRC-32 polynomial, in reflected bit order
+static constexpr uint32_t MultiplyModulo(
+	uint32_t a,
+	uint32_t b)
+{
+	uint32_t product = 0;
+
+	for (uint32_t bit = 1u << 31; bit != 0; bit >>= 1)
+	{
+		if (a & bit) product ^= b;
+
+		b = (b & 1)
+			? (b >> 1) ^ CRC32_POLYNOMIAL
+			: b >> 1;
+	}
+
+	return product;
+}
+
+//x^(2^k) modulo the CRC-32 polynomial for every k, x^1 is 1 << 30 in reflected order
+static constexpr array<uint32_t, 32> BuildPowers()
+{
+	array<uint32_t, 32> powers{};
+
+	uint32_t power = 1u << 30;
+	for (auto& p : powers)
+	{
+		p = power;
+		power = MultiplyModulo(power, power);
+	}
+
+	return powers;
+}
+
+static constexpr array<uint32_t, 32> CRC32_POWERS = BuildPowers();
+
+//Little-endian 32-bit word at p, a single load on little-endian targets
+static uint32_t ReadLittle32(const uint8_t* p);
+
+namespace KalaData
+{
+	uint32_t Checksum::Crc32(
+		const uint8_t* data,
+		size_t size,
+		uint32_t crc)
+	{
+		crc = ~crc;
+
+		while (size >= 8)
+		{
+			uint32_t low = ReadLittle32(data) ^ crc;
+			uint32_t high = ReadLittle32(data + 4);
+
+			crc = CRC32_TABLES[7][low & 0xFF]
+				^ CRC32_TABLES[6][(low >> 8) & 0xFF]
+				^ CRC32_TABLES[5][(low >> 16) & 0xFF]
+				^ CRC32_TABLES[4][low >> 24]
+				^ CRC32_TABLES[3][high & 0xFF]
+				^ CRC32_TABLES[2][(high >> 8) & 0xFF]
+				^ CRC32_TABLES[1][(high >> 16) & 0xFF]
+				^ CRC32_TABLES[0][high >> 24];
+
+			data += 8;
+			size -= 8;
+		}
+
+		while (size-- > 0)
+		{
+			crc = CRC32_TABLES[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+		}
+
+		return ~crc;
+	}
+
+	uint32_t Checksum::Combine(
+		uint32_t crcA,
+		uint32_t crcB,
+		uint64_t sizeB)
+	{
+		//appending sizeB bytes multiplies crcA by x^(8 * sizeB), built from the
+		//powers of the bits of sizeB, starting at x^8 for one byte
+		uint32_t shift = 1u << 31;
+		for (size_t k = 3; sizeB > 0; sizeB >>= 1, k++)
+		{
+			if (sizeB & 1) shift = MultiplyModulo(CRC32_POWERS[k & 31], shift);
+		}
+
+		return MultiplyModulo(shift, crcA) ^ crcB;
+	}
+}
+
+uint32_t ReadLittle32(const uint8_t* p)
+{
+	return static_cast<uint32_t>(p[0])
+		| (static_cast<uint32_t>(p[1]) << 8)
+		| (static_cast<uint32_t>(p[2]) << 16)
+		| (static_cast<uint32_t>(p[3]) << 24);
+}
\ No newline at end of file
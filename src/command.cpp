@@ -6,7 +6,6 @@
 #include <sstream>
 #include <string>
 #include <filesystem>
-#include <iomanip>
 #include <fstream>
 #include <unordered_map>
 #include <vector>
@@ -18,6 +17,8 @@
 #include "core.hpp"
 #include "command.hpp"
 #include "compress.hpp"
+#include "longmatch.hpp"
+#include "dictionary.hpp"
 
 using KalaData::Core;
 using KalaData::MessageType;
@@ -30,7 +31,6 @@ using std::filesystem::exists;
 using std::filesystem::remove;
 using std::filesystem::is_regular_file;
 using std::filesystem::is_directory;
-using std::filesystem::file_size;
 using std::filesystem::is_empty;
 using std::filesystem::weakly_canonical;
 using std::filesystem::current_path;
@@ -38,9 +38,6 @@ using std::filesystem::create_directories;
 using std::filesystem::remove;
 using std::filesystem::remove_all;
 using std::filesystem::directory_iterator;
-using std::filesystem::recursive_directory_iterator;
-using std::fixed;
-using std::setprecision;
 using std::ofstream;
 using std::ios;
 using std::unordered_map;
@@ -49,14 +46,11 @@ using std::exception;
 using std::cin;
 using std::toupper;
 using std::ranges::any_of;
+using std::ranges::all_of;
 using std::equal;
 
-static uint64_t GetFolderSize(const string& folderPath);
-
 static bool CanWriteToFolder(const string& folderPath);
 
-static string ConvertSizeToString(uint64_t size);
-
 static string ResolvePath(
 	const string& origin,
 	bool checkExistence = false);
@@ -65,15 +59,21 @@ struct Preset
 {
 	size_t window;
 	size_t lookahead;
+	size_t maxChain;
+	KalaData::MatchFinderType matchFinder;
+	size_t lazyDepth;
+	KalaData::ParserType parser;
+	KalaData::EntropyCoderType entropyCoder;
 };
 
 static const unordered_map<string, Preset> presets =
 {
-	{ "fastest",  { KalaData::WINDOW_SIZE_FASTEST,  KalaData::LOOKAHEAD_FASTEST  } },
-	{ "fast",     { KalaData::WINDOW_SIZE_FAST,     KalaData::LOOKAHEAD_FAST     } },
-	{ "balanced", { KalaData::WINDOW_SIZE_BALANCED, KalaData::LOOKAHEAD_BALANCED } },
-	{ "slow",     { KalaData::WINDOW_SIZE_SLOW,     KalaData::LOOKAHEAD_SLOW     } },
-	{ "archive",  { KalaData::WINDOW_SIZE_ARCHIVE,  KalaData::LOOKAHEAD_ARCHIVE  } }
+	{ "fastest",  { KalaData::WINDOW_SIZE_FASTEST,  KalaData::LOOKAHEAD_FASTEST,  KalaData::MAX_CHAIN_FASTEST,  KalaData::MATCH_FINDER_FASTEST,  KalaData::LAZY_DEPTH_FASTEST,  KalaData::PARSER_FASTEST,  KalaData::ENTROPY_CODER_FASTEST  } },
+	{ "fast",     { KalaData::WINDOW_SIZE_FAST,     KalaData::LOOKAHEAD_FAST,     KalaData::MAX_CHAIN_FAST,     KalaData::MATCH_FINDER_FAST,     KalaData::LAZY_DEPTH_FAST,     KalaData::PARSER_FAST,     KalaData::ENTROPY_CODER_FAST     } },
+	{ "balanced", { KalaData::WINDOW_SIZE_BALANCED, KalaData::LOOKAHEAD_BALANCED, KalaData::MAX_CHAIN_BALANCED, KalaData::MATCH_FINDER_BALANCED, KalaData::LAZY_DEPTH_BALANCED, KalaData::PARSER_BALANCED, KalaData::ENTROPY_CODER_BALANCED } },
+	{ "slow",     { KalaData::WINDOW_SIZE_SLOW,     KalaData::LOOKAHEAD_SLOW,     KalaData::MAX_CHAIN_SLOW,     KalaData::MATCH_FINDER_SLOW,     KalaData::LAZY_DEPTH_SLOW,     KalaData::PARSER_SLOW,     KalaData::ENTROPY_CODER_SLOW     } },
+	{ "archive",  { KalaData::WINDOW_SIZE_ARCHIVE,  KalaData::LOOKAHEAD_ARCHIVE,  KalaData::MAX_CHAIN_ARCHIVE,  KalaData::MATCH_FINDER_ARCHIVE,  KalaData::LAZY_DEPTH_ARCHIVE,  KalaData::PARSER_ARCHIVE,  KalaData::ENTROPY_CODER_ARCHIVE  } },
+	{ "ultra",    { KalaData::WINDOW_SIZE_ULTRA,    KalaData::LOOKAHEAD_ULTRA,    KalaData::MAX_CHAIN_ULTRA,    KalaData::MATCH_FINDER_ULTRA,    KalaData::LAZY_DEPTH_ULTRA,    KalaData::PARSER_ULTRA,    KalaData::ENTROPY_CODER_ULTRA    } }
 };
 
 static const vector<string> restrictedFileNames
@@ -104,9 +104,6 @@ static const vector<string> restrictedFileNames
 	"LPT9",
 };
 
-//5GB max file size
-constexpr uint64_t maxFolderSize = 5ull * 1024 * 1024 * 1024;
-
 //where user has navigated with --go command
 static string currentPath{};
 
@@ -215,6 +212,55 @@ namespace KalaData
 			return;
 		}
 
+		else if (parameters.size() == 2
+			&& parameters[1] == "--solid")
+		{
+			Command_ToggleSolidMode();
+			return;
+		}
+
+		else if (parameters.size() == 3
+			&& parameters[1] == "--blocks")
+		{
+			Command_SetFileBlockSize(parameters[2]);
+			return;
+		}
+
+		else if (parameters.size() == 2
+			&& parameters[1] == "--linked")
+		{
+			Command_ToggleLinkedBlocks();
+			return;
+		}
+
+		else if (parameters.size() == 3
+			&& parameters[1] == "--ldm")
+		{
+			Command_SetLongMatchMemory(parameters[2]);
+			return;
+		}
+
+		else if (parameters.size() == 3
+			&& parameters[1] == "--threads")
+		{
+			Command_SetThreadCount(parameters[2]);
+			return;
+		}
+
+		else if (parameters.size() == 3
+			&& parameters[1] == "--dict")
+		{
+			Command_SetDictionary(parameters[2]);
+			return;
+		}
+
+		else if (parameters.size() == 4
+			&& parameters[1] == "--train")
+		{
+			Command_Train(parameters[2], parameters[3]);
+			return;
+		}
+
 		else if (parameters.size() == 4
 			&& parameters[1] == "--c")
 		{
@@ -229,6 +275,20 @@ namespace KalaData
 			return;
 		}
 
+		else if (parameters.size() == 5
+			&& parameters[1] == "--extract")
+		{
+			Command_Extract(parameters[2], parameters[3], parameters[4]);
+			return;
+		}
+
+		else if (parameters.size() == 3
+			&& parameters[1] == "--contents")
+		{
+			Command_Contents(parameters[2]);
+			return;
+		}
+
 		else if (parameters.size() == 2
 			&& parameters[1] == "--exit")
 		{
@@ -311,8 +371,17 @@ namespace KalaData
 			<< "  --delete path\n"
 			<< "  --sm mode\n"
 			<< "  --tvb\n"
+			<< "  --solid\n"
+			<< "  --blocks megabytes\n"
+			<< "  --linked\n"
+			<< "  --ldm megabytes\n"
+			<< "  --threads count\n"
+			<< "  --dict path\n"
+			<< "  --train\n"
 			<< "  --c\n"
 			<< "  --dc\n"
+			<< "  --extract archive path target\n"
+			<< "  --contents path\n"
 			<< "  --exit\n\n"
 
 			<< "====================\n";
@@ -420,27 +489,62 @@ namespace KalaData
 				<< "- fastest\n"
 				<< "  - best for temporary files\n"
 				<< "  - window size: " << WINDOW_SIZE_FASTEST << " bytes\n"
-				<< "  - lookahead: " << LOOKAHEAD_FASTEST << "\n\n"
+				<< "  - lookahead: " << LOOKAHEAD_FASTEST << "\n"
+				<< "  - max chain: " << MAX_CHAIN_FASTEST << "\n"
+				<< "  - match finder: " << Compress::MatchFinderName(MATCH_FINDER_FASTEST) << "\n"
+				<< "  - lazy depth: " << LAZY_DEPTH_FASTEST << "\n"
+				<< "  - parser: " << Compress::ParserName(PARSER_FASTEST) << "\n"
+				<< "  - entropy coder: " << Compress::EntropyCoderName(ENTROPY_CODER_FASTEST) << "\n\n"
 				
 				<< "- fast\n"
 				<< "  - best for quick backups\n"
 				<< "  - window size: " << WINDOW_SIZE_FAST<< " bytes\n"
-				<< "  - lookahead: " << LOOKAHEAD_FAST << "\n\n"
+				<< "  - lookahead: " << LOOKAHEAD_FAST << "\n"
+				<< "  - max chain: " << MAX_CHAIN_FAST << "\n"
+				<< "  - match finder: " << Compress::MatchFinderName(MATCH_FINDER_FAST) << "\n"
+				<< "  - lazy depth: " << LAZY_DEPTH_FAST << "\n"
+				<< "  - parser: " << Compress::ParserName(PARSER_FAST) << "\n"
+				<< "  - entropy coder: " << Compress::EntropyCoderName(ENTROPY_CODER_FAST) << "\n\n"
 				
 				<< "- balanced\n"
 				<< "  - best for general use\n"
 				<< "  - window size: " << WINDOW_SIZE_BALANCED << " bytes\n"
-				<< "  - lookahead: " << LOOKAHEAD_BALANCED << "\n\n"
+				<< "  - lookahead: " << LOOKAHEAD_BALANCED << "\n"
+				<< "  - max chain: " << MAX_CHAIN_BALANCED << "\n"
+				<< "  - match finder: " << Compress::MatchFinderName(MATCH_FINDER_BALANCED) << "\n"
+				<< "  - lazy depth: " << LAZY_DEPTH_BALANCED << "\n"
+				<< "  - parser: " << Compress::ParserName(PARSER_BALANCED) << "\n"
+				<< "  - entropy coder: " << Compress::EntropyCoderName(ENTROPY_CODER_BALANCED) << "\n\n"
 				
 				<< "- slow\n"
 				<< "  - best for long term storage\n"
 				<< "  - window size: " << WINDOW_SIZE_SLOW << " bytes\n"
-				<< "  - lookahead: " << LOOKAHEAD_SLOW << "\n\n"
+				<< "  - lookahead: " << LOOKAHEAD_SLOW << "\n"
+				<< "  - max chain: " << MAX_CHAIN_SLOW << "\n"
+				<< "  - match finder: " << Compress::MatchFinderName(MATCH_FINDER_SLOW) << "\n"
+				<< "  - lazy depth: " << LAZY_DEPTH_SLOW << "\n"
+				<< "  - parser: " << Compress::ParserName(PARSER_SLOW) << "\n"
+				<< "  - entropy coder: " << Compress::EntropyCoderName(ENTROPY_CODER_SLOW) << "\n\n"
 				
 				<< "- archive\n"
 				<< "  - best for maximum compression\n"
 				<< "  - window size: " << WINDOW_SIZE_ARCHIVE << " bytes\n"
-				<< "  - lookahead: " << LOOKAHEAD_ARCHIVE << "\n";
+				<< "  - lookahead: " << LOOKAHEAD_ARCHIVE << "\n"
+				<< "  - max chain: " << MAX_CHAIN_ARCHIVE << "\n"
+				<< "  - match finder: " << Compress::MatchFinderName(MATCH_FINDER_ARCHIVE) << "\n"
+				<< "  - lazy depth: " << LAZY_DEPTH_ARCHIVE << "\n"
+				<< "  - parser: " << Compress::ParserName(PARSER_ARCHIVE) << "\n"
+				<< "  - entropy coder: " << Compress::EntropyCoderName(ENTROPY_CODER_ARCHIVE) << "\n\n"
+
+				<< "- ultra\n"
+				<< "  - best for cold storage, decompression is several times slower\n"
+				<< "  - window size: " << WINDOW_SIZE_ULTRA << " bytes\n"
+				<< "  - lookahead: " << LOOKAHEAD_ULTRA << "\n"
+				<< "  - max chain: " << MAX_CHAIN_ULTRA << "\n"
+				<< "  - match finder: " << Compress::MatchFinderName(MATCH_FINDER_ULTRA) << "\n"
+				<< "  - lazy depth: " << LAZY_DEPTH_ULTRA << "\n"
+				<< "  - parser: " << Compress::ParserName(PARSER_ULTRA) << "\n"
+				<< "  - entropy coder: " << Compress::EntropyCoderName(ENTROPY_CODER_ULTRA) << "\n";
 
 			Core::PrintMessage(ss.str());
 
@@ -476,6 +580,135 @@ namespace KalaData
 			return;
 		}
 
+		else if (commandName == "solid"
+			|| commandName == "--solid")
+		{
+			ostringstream ss{};
+
+			ss << "Toggles solid compression on and off.\n"
+				<< "If true, then files are sorted by extension and packed into shared blocks "
+				<< "of up to " << SOLID_BLOCK_SIZE / (1024 * 1024) << "MB that are compressed as one stream, "
+				<< "so small similar files can reuse each other's data.\n"
+				<< "Files that fill a block on their own are compressed separately as usual.\n"
+				<< "Archives made in solid mode decompress with the regular '--dc' command.\n";
+
+			Core::PrintMessage(ss.str());
+
+			return;
+		}
+
+		else if (commandName == "blocks"
+			|| commandName == "--blocks")
+		{
+			ostringstream ss{};
+
+			ss << "Sets the size of the blocks large files are split into in MB.\n"
+				<< "Files larger than one block are compressed and decompressed block by block, so memory use "
+				<< "depends on the block size and thread count instead of the file size. With '--threads' "
+				<< "the blocks of one file are compressed and decompressed on different threads.\n"
+				<< "Every block starts with an empty window unless '--linked' is on, so smaller blocks give slightly bigger archives.\n"
+				<< "Files are not split while '--ldm' is on, so the long-distance matcher sees the whole file.\n"
+				<< "Default: " << FILE_BLOCK_SIZE_DEFAULT / (1024 * 1024) << " MB, "
+				<< "supported range: " << FILE_BLOCK_SIZE_MIN / (1024 * 1024) << "-" << FILE_BLOCK_SIZE_MAX / (1024 * 1024) << " MB\n";
+
+			Core::PrintMessage(ss.str());
+
+			return;
+		}
+
+		else if (commandName == "linked"
+			|| commandName == "--linked")
+		{
+			ostringstream ss{};
+
+			ss << "Toggles linked blocks on and off.\n"
+				<< "If true, then every block of a large file starts with the end of the block before it as its window, "
+				<< "so matches can cross block borders and the archive gets smaller.\n"
+				<< "Linked blocks still compress on all threads, but the blocks of one file "
+				<< "decompress one after another.\n";
+
+			Core::PrintMessage(ss.str());
+
+			return;
+		}
+
+		else if (commandName == "ldm"
+			|| commandName == "--ldm")
+		{
+			ostringstream ss{};
+
+			ss << "Sets the memory of the long-distance matcher in MB, '0' turns it off (default).\n"
+				<< "The long-distance matcher finds repeats of at least " << LONG_MATCH_MIN << " bytes "
+				<< "that are further back than the window of the compression mode, "
+				<< "anywhere in the same file or solid block.\n"
+				<< "Its memory is separate from the window, more memory samples large files more densely.\n"
+				<< "While it is on, large files are compressed whole instead of in blocks, so memory use grows with the largest file "
+				<< "and each file is compressed and decompressed on one thread.\n"
+				<< "Supported range: 0-" << LONG_MATCH_MEMORY_MAX / (1024 * 1024) << " MB\n";
+
+			Core::PrintMessage(ss.str());
+
+			return;
+		}
+
+		else if (commandName == "threads"
+			|| commandName == "--threads")
+		{
+			ostringstream ss{};
+
+			ss << "Sets how many files or solid blocks compression and decompression work on at the same time, "
+				<< "between '0' and '" << MAX_THREAD_COUNT << "' (default '1').\n"
+				<< "'0' starts one thread per hardware thread, this machine has '" << ThreadPool::ResolveThreadCount(0) << "'.\n"
+				<< "The archive is the same for every thread count, "
+				<< "but every thread holds its own file and match finder in memory.\n";
+
+			Core::PrintMessage(ss.str());
+
+			return;
+		}
+
+		else if (commandName == "dict"
+			|| commandName == "--dict")
+		{
+			ostringstream ss{};
+
+			ss << "Sets the trained '.kdict' dictionary that primes the window of every compressed file, "
+				<< "'none' clears it (default).\n"
+				<< "The dictionary is stored once at the front of the archive, "
+				<< "so archives made with it decompress with the regular '--dc' command.\n"
+				<< "Dictionaries help most with many small files that look alike, "
+				<< "create one with '--train'.\n";
+
+			Core::PrintMessage(ss.str());
+
+			return;
+		}
+
+		else if (commandName == "train"
+			|| commandName == "--train")
+		{
+			ostringstream ss{};
+
+			ss << "Takes in a directory of sample files and trains a " << DICTIONARY_SIZE / 1024 << "KB "
+				<< "dictionary from them into a '.kdict' file inside the target path parent directory.\n"
+				<< "At most " << DICTIONARY_MAX_SAMPLES / (1024 * 1024) << "MB of samples are read.\n\n"
+				<< "Requirements and restrictions:\n\n"
+
+				<< "Origin:\n"
+				<< "  - path must exist\n"
+				<< "  - path must be a directory\n"
+				<< "  - directory must not be empty\n\n"
+
+				<< "Target:\n"
+				<< "  - path must not exist\n"
+				<< "  - path must have the '.kdict' extension\n"
+				<< "  - path parent directory must be writable\n";
+
+			Core::PrintMessage(ss.str());
+
+			return;
+		}
+
 		else if (commandName == "c"
 			|| commandName == "--c")
 		{
@@ -487,8 +720,7 @@ namespace KalaData
 				<< "Origin:\n"
 				<< "  - path must exist\n"
 				<< "  - path must be a directory\n"
-				<< "  - directory must not be empty\n"
-				<< "  - directory size must not exceed 5GB\n\n"
+				<< "  - directory must not be empty\n\n"
 
 				<< "Target:\n"
 				<< "  - path must not exist\n"
@@ -523,6 +755,53 @@ namespace KalaData
 			return;
 		}
 
+		else if (commandName == "extract"
+			|| commandName == "--extract")
+		{
+			ostringstream ss{};
+
+			ss << "Takes in a compressed '.kdat' file path, the path of one file inside it and a target directory, "
+				<< "like '--extract game.kdat config/settings.ini out'.\n"
+				<< "Only that file is decompressed into the target directory, "
+				<< "the central directory at the end of the archive points straight to its data.\n"
+				<< "Type '--contents' to list the paths inside an archive.\n\n"
+				<< "Requirements and restrictions:\n\n"
+
+				<< "Origin:\n"
+				<< "  - path must exist\n"
+				<< "  - path must be a regular file\n"
+				<< "  - path must have the '.kdat' extension\n"
+				<< "  - archive must contain the file\n\n"
+
+				<< "Target:\n"
+				<< "  - path must exist\n"
+				<< "  - path must be a directory\n"
+				<< "  - directory must be writable\n";
+
+			Core::PrintMessage(ss.str());
+
+			return;
+		}
+
+		else if (commandName == "contents"
+			|| commandName == "--contents")
+		{
+			ostringstream ss{};
+
+			ss << "Lists the size, stored size, method, checksum and path of every file inside a compressed '.kdat' file "
+				<< "from its central directory, nothing is decompressed.\n\n"
+				<< "Requirements and restrictions:\n\n"
+
+				<< "Origin:\n"
+				<< "  - path must exist\n"
+				<< "  - path must be a regular file\n"
+				<< "  - path must have the '.kdat' extension\n";
+
+			Core::PrintMessage(ss.str());
+
+			return;
+		}
+
 		else if (commandName == "exit"
 			|| commandName == "--exit")
 		{
@@ -748,12 +1027,22 @@ namespace KalaData
 
 		Compress::SetWindowSize(it->second.window);
 		Compress::SetLookAhead(it->second.lookahead);
+		Compress::SetMaxChain(it->second.maxChain);
+		Compress::SetMatchFinder(it->second.matchFinder);
+		Compress::SetLazyDepth(it->second.lazyDepth);
+		Compress::SetParser(it->second.parser);
+		Compress::SetEntropyCoder(it->second.entropyCoder);
 
 		ostringstream ss{};
 
 		ss << "Set compression mode to '" + mode + "'!\n"
 			<< "  Window size is '" << Compress::GetWindowSize() << " bytes'\n"
-			<< "  Lookahead is '" << Compress::GetLookAhead() << "'\n";
+			<< "  Lookahead is '" << Compress::GetLookAhead() << "'\n"
+			<< "  Max chain is '" << Compress::GetMaxChain() << "'\n"
+			<< "  Match finder is '" << Compress::MatchFinderName(Compress::GetMatchFinder()) << "'\n"
+			<< "  Lazy depth is '" << Compress::GetLazyDepth() << "'\n"
+			<< "  Parser is '" << Compress::ParserName(Compress::GetParser()) << "'\n"
+			<< "  Entropy coder is '" << Compress::EntropyCoderName(Compress::GetEntropyCoder()) << "'\n";
 
 		Core::PrintMessage(
 			ss.str(),
@@ -773,7 +1062,180 @@ namespace KalaData
 			"Set compression verbose logging state to '" + stateStr + "'!\n");
 	}
 
-	void Command::Command_Compress(
+	void Command::Command_ToggleSolidMode()
+	{
+		bool state = Compress::IsSolidModeEnabled();
+		state = !state;
+
+		Compress::SetSolidModeState(state);
+
+		string stateStr = state ? "true" : "false";
+
+		Core::PrintMessage(
+			"Set solid compression state to '" + stateStr + "'!\n");
+	}
+
+	void Command::Command_SetFileBlockSize(const string& megabytes)
+	{
+		size_t maxMegabytes = FILE_BLOCK_SIZE_MAX / (1024 * 1024);
+
+		size_t minMegabytes = FILE_BLOCK_SIZE_MIN / (1024 * 1024);
+
+		if (megabytes.empty()
+			|| megabytes.size() > 2
+			|| !all_of(megabytes, [](char c) { return isdigit(static_cast<unsigned char>(c)) != 0; })
+			|| stoul(megabytes) < minMegabytes
+			|| stoul(megabytes) > maxMegabytes)
+		{
+			Core::PrintMessage(
+				"Block size '" + megabytes + "' must be a whole number of MB between '" + to_string(minMegabytes) + "' and '" + to_string(maxMegabytes) + "'!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		size_t blockSize = stoul(megabytes) * 1024 * 1024;
+		Compress::SetFileBlockSize(blockSize);
+
+		Core::PrintMessage(
+			"Set large file block size to '" + megabytes + " MB'!\n",
+			MessageType::MESSAGETYPE_SUCCESS);
+	}
+
+	void Command::Command_ToggleLinkedBlocks()
+	{
+		bool state = Compress::IsLinkedBlocksEnabled();
+		state = !state;
+
+		Compress::SetLinkedBlocksState(state);
+
+		string stateStr = state ? "true" : "false";
+
+		Core::PrintMessage(
+			"Set linked blocks state to '" + stateStr + "'!\n");
+	}
+
+	void Command::Command_SetLongMatchMemory(const string& megabytes)
+	{
+		size_t maxMegabytes = LONG_MATCH_MEMORY_MAX / (1024 * 1024);
+
+		if (megabytes.empty()
+			|| megabytes.size() > 4
+			|| !all_of(megabytes, [](char c) { return isdigit(static_cast<unsigned char>(c)) != 0; })
+			|| stoul(megabytes) > maxMegabytes)
+		{
+			Core::PrintMessage(
+				"Long-distance matcher memory '" + megabytes + "' must be a whole number of MB between '0' and '" + to_string(maxMegabytes) + "'!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		size_t memory = stoul(megabytes) * 1024 * 1024;
+		Compress::SetLongMatchMemory(memory);
+
+		if (memory == 0)
+		{
+			Core::PrintMessage(
+				"Turned off long-distance matching!\n",
+				MessageType::MESSAGETYPE_SUCCESS);
+
+			return;
+		}
+
+		Core::PrintMessage(
+			"Set long-distance matcher memory to '" + megabytes + " MB'!\n",
+			MessageType::MESSAGETYPE_SUCCESS);
+
+		Core::PrintMessage(
+			"Large files are compressed whole while long-distance matching is on, memory use grows with the largest file!\n",
+			MessageType::MESSAGETYPE_WARNING);
+	}
+
+	void Command::Command_SetThreadCount(const string& count)
+	{
+		if (count.empty()
+			|| count.size() > 3
+			|| !all_of(count, [](char c) { return isdigit(static_cast<unsigned char>(c)) != 0; })
+			|| stoul(count) > MAX_THREAD_COUNT)
+		{
+			Core::PrintMessage(
+				"Thread count '" + count + "' must be a whole number between '0' and '" + to_string(MAX_THREAD_COUNT) + "'!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		size_t threadCount = stoul(count);
+		Compress::SetThreadCount(threadCount);
+
+		if (threadCount == 0)
+		{
+			Core::PrintMessage(
+				"Set thread count to one per hardware thread ('" + to_string(ThreadPool::ResolveThreadCount(0)) + "')!\n",
+				MessageType::MESSAGETYPE_SUCCESS);
+
+			return;
+		}
+
+		Core::PrintMessage(
+			"Set thread count to '" + count + "'!\n",
+			MessageType::MESSAGETYPE_SUCCESS);
+	}
+
+	void Command::Command_SetDictionary(const string& target)
+	{
+		if (target == "none")
+		{
+			Compress::SetDictionary({});
+
+			Core::PrintMessage(
+				"Cleared compression dictionary!\n",
+				MessageType::MESSAGETYPE_SUCCESS);
+
+			return;
+		}
+
+		auto canonicalTarget = ResolvePath(target, true);
+
+		if (canonicalTarget.empty()) return;
+
+		if (!is_regular_file(canonicalTarget))
+		{
+			Core::PrintMessage(
+				"Dictionary '" + canonicalTarget + "' must be a regular file!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		if (path(canonicalTarget).extension().string() != ".kdict")
+		{
+			Core::PrintMessage(
+				"Dictionary '" + canonicalTarget + "' must have the '.kdict' extension!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		vector<uint8_t> dictionary{};
+		if (!Dictionary::Load(canonicalTarget, dictionary))
+		{
+			Core::PrintMessage(
+				"Dictionary '" + canonicalTarget + "' is not a valid KalaData dictionary!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		Compress::SetDictionary(dictionary);
+
+		Core::PrintMessage(
+			"Set compression dictionary to '" + canonicalTarget + "' (" + to_string(dictionary.size()) + " bytes)!\n",
+			MessageType::MESSAGETYPE_SUCCESS);
+	}
+
+	void Command::Command_Train(
 		const string& origin,
 		const string& target)
 	{
@@ -810,13 +1272,69 @@ namespace KalaData
 			return;
 		}
 
-		uint64_t originSize = GetFolderSize(canonicalOrigin);
-		if (originSize > maxFolderSize)
+		if (exists(canonicalTarget))
+		{
+			Core::PrintMessage(
+				"Target '" + canonicalTarget + "' already exists!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		if (path(canonicalTarget).extension().string() != ".kdict")
+		{
+			Core::PrintMessage(
+				"Target path '" + canonicalTarget + "' must have the '.kdict' extension!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		string targetParentFolder = path(canonicalTarget).parent_path().string();
+		if (!CanWriteToFolder(targetParentFolder))
+		{
+			Core::PrintMessage(
+				"Unable to write to target parent directory '" + targetParentFolder + "'!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		Dictionary::TrainToFile(canonicalOrigin, canonicalTarget);
+	}
+
+	void Command::Command_Compress(
+		const string& origin,
+		const string& target)
+	{
+		if (origin == "/"
+			|| origin == "\\")
+		{
+			Core::PrintMessage(
+				"Path '" + origin + "' is not allowed as origin path!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		auto canonicalOrigin = ResolvePath(origin, true);
+		auto canonicalTarget = ResolvePath(target);
+
+		if (canonicalOrigin.empty()) return;
+
+		if (!is_directory(canonicalOrigin))
 		{
-			string convertedOriginSize = ConvertSizeToString(originSize);
+			Core::PrintMessage(
+				"Origin '" + canonicalOrigin + "' must be a directory!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
 
+		if (is_empty(canonicalOrigin))
+		{
 			Core::PrintMessage(
-				"Origin '" + canonicalOrigin + "' size '" + convertedOriginSize + "' exceeds max allowed size '5.00GB'!\n",
+				"Origin '" + canonicalOrigin + "' must not be an empty directory!\n",
 				MessageType::MESSAGETYPE_ERROR);
 
 			return;
@@ -911,22 +1429,95 @@ namespace KalaData
 		Compress::DecompressToFolder(canonicalOrigin, canonicalTarget);
 	}
 
-	void Command::Command_Exit()
+	void Command::Command_Extract(
+		const string& origin,
+		const string& entryPath,
+		const string& target)
 	{
-		Core::Shutdown();
-	}
-}
+		auto canonicalOrigin = ResolvePath(origin, true);
+		auto canonicalTarget = ResolvePath(target);
 
-uint64_t GetFolderSize(const string& folderPath)
-{
-	uint64_t size{};
+		if (canonicalOrigin.empty()) return;
+
+		if (!is_regular_file(canonicalOrigin))
+		{
+			Core::PrintMessage(
+				"Origin '" + canonicalOrigin + "' must be a regular file!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		if (path(canonicalOrigin).extension().string() != ".kdat")
+		{
+			Core::PrintMessage(
+				"Origin '" + canonicalOrigin + "' must have the '.kdat' extension!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		if (!exists(canonicalTarget))
+		{
+			Core::PrintMessage(
+				"Target directory '" + canonicalTarget + "' does not exist!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		if (!is_directory(canonicalTarget))
+		{
+			Core::PrintMessage(
+				"Target '" + canonicalTarget + "' must be a directory!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		if (!CanWriteToFolder(canonicalTarget))
+		{
+			Core::PrintMessage(
+				"Unable to write to target directory '" + canonicalTarget + "'!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		Compress::ExtractFile(canonicalOrigin, entryPath, canonicalTarget);
+	}
 
-	for (auto& p : recursive_directory_iterator(folderPath))
+	void Command::Command_Contents(const string& origin)
 	{
-		if (is_regular_file(p)) size += file_size(p);
+		auto canonicalOrigin = ResolvePath(origin, true);
+
+		if (canonicalOrigin.empty()) return;
+
+		if (!is_regular_file(canonicalOrigin))
+		{
+			Core::PrintMessage(
+				"Origin '" + canonicalOrigin + "' must be a regular file!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		if (path(canonicalOrigin).extension().string() != ".kdat")
+		{
+			Core::PrintMessage(
+				"Origin '" + canonicalOrigin + "' must have the '.kdat' extension!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			return;
+		}
+
+		Compress::ListContents(canonicalOrigin);
 	}
 
-	return size;
+	void Command::Command_Exit()
+	{
+		Core::Shutdown();
+	}
 }
 
 bool CanWriteToFolder(const string& folderPath)
@@ -951,18 +1542,6 @@ bool CanWriteToFolder(const string& folderPath)
 	}
 }
 
-string ConvertSizeToString(uint64_t size)
-{
-	ostringstream ss{};
-
-	ss << fixed
-		<< setprecision(2)
-		<< static_cast<double>(size) / (1024ull * 1024 * 1024)
-		<< "GB";
-
-	return ss.str();
-}
-
 string ResolvePath(
 	const string& origin,
 	bool checkExistence)
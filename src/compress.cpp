@@ -8,19 +8,66 @@
 #include <vector>
 #include <sstream>
 #include <string>
+#include <cstring>
 #include <chrono>
 #include <iomanip>
-#include <queue>
-#include <map>
 #include <memory>
+#include <algorithm>
+#include <bit>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <cmath>
 
 #include "core.hpp"
 #include "command.hpp"
 #include "compress.hpp"
+#include "matchfinder.hpp"
+#include "huffman.hpp"
+#include "fse.hpp"
+#include "rangecoder.hpp"
+#include "tokenstreams.hpp"
+#include "longmatch.hpp"
+#include "dictionary.hpp"
+#include "checksum.hpp"
+#include "threadpool.hpp"
 
 using KalaData::Core;
 using KalaData::MessageType;
 using KalaData::Compress;
+using KalaData::MatchFinder;
+using KalaData::Match;
+using KalaData::Huffman;
+using KalaData::Fse;
+using KalaData::RangeCoder;
+using KalaData::TokenStreams;
+using KalaData::ParserType;
+using KalaData::EntropyCoderType;
+using KalaData::MIN_MATCH;
+using KalaData::OffsetSlot;
+using KalaData::OffsetExtraBits;
+using KalaData::Token;
+using KalaData::TokenWriter;
+using KalaData::LENGTH_ESCAPE;
+using KalaData::LENGTH_ESCAPE_BITS;
+using KalaData::MAX_MATCH;
+using KalaData::RepHistory;
+using KalaData::REP_COUNT;
+using KalaData::OFFSET_SLOT_COUNT;
+using KalaData::WILDCOPY_OVERLENGTH;
+using KalaData::CopyMatch;
+using KalaData::SOLID_BLOCK_SIZE;
+using KalaData::SOLID_MAX_FILE_SIZE;
+using KalaData::SOLID_PROBE_SIZE;
+using KalaData::FILE_BLOCK_SIZE_MAX;
+using KalaData::WINDOW_SIZE_FASTEST;
+using KalaData::LongMatchFinder;
+using KalaData::LongMatch;
+using KalaData::DICTIONARY_MAX_SIZE;
+using KalaData::Checksum;
+using KalaData::ThreadPool;
+using KalaData::MatchFinderType;
 
 using std::filesystem::path;
 using std::filesystem::create_directories;
@@ -29,12 +76,14 @@ using std::filesystem::is_regular_file;
 using std::filesystem::weakly_canonical;
 using std::filesystem::file_size;
 using std::filesystem::recursive_directory_iterator;
+using std::filesystem::resize_file;
 using std::ofstream;
+using std::fstream;
 using std::ifstream;
 using std::ios;
+using std::streampos;
 using std::streamoff;
 using std::streamsize;
-using std::istreambuf_iterator;
 using std::vector;
 using std::ostringstream;
 using std::string;
@@ -44,102 +93,519 @@ using std::chrono::duration;
 using std::chrono::seconds;
 using std::fixed;
 using std::setprecision;
-using std::map;
-using std::priority_queue;
+using std::setw;
+using std::setfill;
+using std::left;
+using std::hex;
 using std::unique_ptr;
+using std::make_shared;
+using std::future;
+using std::packaged_task;
+using std::atomic;
+using std::mutex;
+using std::lock_guard;
+using std::pair;
 using std::move;
-using std::make_unique;
 using std::memcmp;
+using std::memcpy;
+using std::min;
+using std::max;
+using std::max_element;
+using std::fill;
+using std::sort;
+using std::stable_partition;
+using std::bit_ceil;
 
-constexpr size_t MIN_MATCH = 3;
+//positions per optimal parse block, bounds the candidate and cost arrays
+constexpr size_t OPTIMAL_BLOCK_SIZE = static_cast<size_t>(64 * 1024);
+
+//price the block once with the running statistics, then again with its own
+constexpr size_t OPTIMAL_PASSES = 2;
+
+//matches at least this long are taken without pricing the positions they cover
+constexpr size_t OPTIMAL_NICE_LENGTH = 128;
+
+//the archive ends with directory offset, stored and original directory size, entry count,
+//directory checksum, directory method, directory version and DIRECTORY_MAGIC
+constexpr size_t DIRECTORY_TRAILER_SIZE = 40;
+constexpr uint16_t DIRECTORY_VERSION = 1;
+constexpr char DIRECTORY_MAGIC[4] = { 'K', 'D', 'I', 'R' };
+
+//fixed fields of one directory record, its path comes on top
+constexpr uint64_t DIRECTORY_RECORD_SIZE = 41;
+
+//longest relative path the directory size is checked against
+constexpr uint64_t DIRECTORY_MAX_PATH = 4096;
+
+//archives with more entries than this are treated as corrupted
+constexpr uint32_t MAX_ENTRY_COUNT = 100000;
+
+//files split into blocks (method 7) start with block size, history size and block count,
+//followed by the method and stored size of every block
+constexpr uint64_t FILE_BLOCK_HEADER_SIZE = 16;
+constexpr uint64_t FILE_BLOCK_RECORD_SIZE = 9;
 
 enum class ForceCloseType
 {
 	TYPE_COMPRESSION,
 	TYPE_DECOMPRESSION,
 	TYPE_COMPRESSION_BUFFER,
-	TYPE_DECOMPRESSION_BUFFER,
-	TYPE_HUFFMAN_ENCODE,
-	TYPE_HUFFMAN_DECODE
+	TYPE_DECOMPRESSION_BUFFER
+};
+
+//Match finder that already holds the dictionary, shared by every buffer with the same window
+struct PrimedFinder
+{
+	size_t windowSize;
+	unique_ptr<MatchFinder> finder;
 };
 
-struct Token
+//Settings of one compression run, copied from Compress when it starts so every
+//worker reads the same values, plus the dictionary match finders they share
+struct CompressContext
 {
-	bool isLiteral;
-	uint8_t literal;
-	uint32_t offset;
-	uint8_t length;
+	size_t windowSize;
+	size_t lookAhead;
+	size_t maxChain;
+	MatchFinderType matchFinder;
+	size_t lazyDepth;
+	ParserType parser;
+	EntropyCoderType entropyCoder;
+	size_t longMatchMemory;
+	vector<uint8_t> dictionary;
+	size_t fileBlockSize;
+	bool linkedBlocks;
+
+	//built once per window size by whichever worker needs one first
+	vector<PrimedFinder> primedFinders;
+	mutex primedLock;
 };
 
-//Huffman tree node
-struct HuffNode
+//Decoded solid block kept between ReadDirectoryEntry calls for the files of the same block
+struct SolidCache
 {
-	uint8_t symbol;
-	size_t freq;
-	unique_ptr<HuffNode> left;
-	unique_ptr<HuffNode> right;
-
-	HuffNode(
-		uint8_t s, 
-		size_t f) :
-		symbol(s),
-		freq(f),
-		left(nullptr),
-		right(nullptr) {}
-
-	HuffNode(
-		unique_ptr<HuffNode> l,
-		unique_ptr<HuffNode> r) :
-		symbol(0),
-		freq(l->freq + r->freq),
-		left(move(l)),
-		right(move(r)) {}
+	uint64_t dataOffset = UINT64_MAX;
+	vector<uint8_t> block;
+};
 
+//Files [first, last) or one block of a large file, planned before the workers start
+struct CompressUnit
+{
+	size_t first;
+	size_t last;
+	//blockCount is 0 unless the file at first is split into blocks
+	uint64_t block;
+	uint64_t blockCount;
+	uint64_t fileSize;
 };
 
-struct NodeCompare
+//Large file whose blocks are being written, its stored size and block table
+//are written as placeholders and filled in after its last block
+struct BlockedEntry
 {
-	bool operator()(
-		const unique_ptr<HuffNode>& a, 
-		const unique_ptr<HuffNode>& b) const
-	{
-		return a->freq > b->freq;
-	}
+	uint64_t storedSizePos;
+	uint64_t tablePos;
+	uint64_t dataSize;
+	uint64_t compressedSize;
+	uint32_t checksum;
+	vector<uint8_t> methods;
+	vector<uint64_t> storedSizes;
+};
+
+//Block table of a large file split into blocks, with the archive offset of every block
+struct FileBlockTable
+{
+	uint64_t blockSize;
+	uint32_t historySize;
+	vector<uint8_t> methods;
+	vector<uint64_t> storedSizes;
+	vector<uint64_t> offsets;
+};
+
+//Directory entries [first, last) decompressed by one worker, or only one block of the entry at first
+struct ExtractUnit
+{
+	size_t first;
+	size_t last;
+	//SIZE_MAX decodes whole entries
+	size_t block;
+};
+
+//One file or solid block, encoded by a worker and written to the archive in order
+struct EncodedUnit
+{
+	//one path per file, solid blocks hold several
+	vector<string> relPaths;
+	//start of every file in the block followed by the block end
+	vector<uint64_t> offsets;
+	//CRC-32 of every file
+	vector<uint32_t> checksums;
+	//storage method of a single file, block method of a solid block or file block
+	uint8_t method;
+	//size the encoder produced, also when the data is stored raw
+	uint64_t compressedSize;
+	//stored bytes
+	vector<uint8_t> data;
+	//why the unit could not be encoded, workers leave reporting it to the writer
+	string error;
+};
+
+//Central directory record of one entry, solid files point at the block they are a slice of
+struct DirectoryEntry
+{
+	string relPath;
+	uint8_t method;
+	uint64_t originalSize;
+	//bytes at dataOffset, the whole block with its header for solid files
+	uint64_t storedSize;
+	uint64_t blockOffset;
+	uint64_t dataOffset;
+	//CRC-32 of the original file
+	uint32_t checksum;
+};
+
+//Symbol counts of the split token streams
+struct TokenStats
+{
+	size_t flags[256];
+	size_t literals[256];
+	size_t lengths[256];
+	size_t slots[256];
+};
+
+//Cost in bits of every symbol of the split token streams
+struct TokenPrices
+{
+	uint32_t flags[256];
+	uint32_t literals[256];
+	uint32_t lengths[256];
+	uint32_t slots[256];
 };
 
 static void ForceClose(
 	const string& message,
 	ForceCloseType type);
 
-//Compress a single buffer into an already open stream
-static vector<uint8_t> CompressBuffer(
-	const vector<uint8_t>& input,
+//Compresses raw with the chosen entropy coder, writes the storage method to outMethod.
+//Tokens may match into history, the dictionary or the end of the previous file block
+static vector<uint8_t> EncodeBuffer(
+	CompressContext& context,
+	const vector<uint8_t>& raw,
+	const vector<uint8_t>& history,
+	const string& name,
+	const string& origin,
+	uint8_t& outMethod);
+
+//Decodes stored data of storage method 3 or 4 back to originalSize bytes,
+//both may match into history, the dictionary or the end of the previous file block.
+//Damaged data returns nothing with the reason in outError
+static vector<uint8_t> DecodeBuffer(
+	uint8_t method,
+	const vector<uint8_t>& stored,
+	size_t originalSize,
+	const vector<uint8_t>& history,
+	const string& origin,
+	string& outError);
+
+//Reads and compresses one whole file, it is stored raw if compression doesn't make it smaller.
+//A file that can't be read returns a unit with only its error set
+static EncodedUnit EncodeFile(
+	CompressContext& context,
+	const path& file,
+	const string& origin,
+	uint64_t fileSize);
+
+//Writes the entry of a file encoded by EncodeFile.
+//Returns false if the archive could not be written
+static bool WriteEntry(
+	ofstream& out,
+	const EncodedUnit& unit,
+	const string& target,
+	uint32_t& compCount,
+	uint32_t& rawCount,
+	uint32_t& emptyCount,
+	vector<DirectoryEntry>& directory);
+
+//True if file has the extension of a compressed format or its first SOLID_PROBE_SIZE bytes
+//are close to 8 bits of entropy per byte. Such files only grow the solid block they join
+static bool IsIncompressible(const path& file);
+
+//Reads files [first, last) into one buffer and compresses it as one solid block.
+//A file that can't be read returns a unit with only its error set
+static EncodedUnit EncodeSolidBlock(
+	CompressContext& context,
+	const vector<path>& files,
+	size_t first,
+	size_t last,
 	const string& origin);
 
-//Decompress from an already open stream into a buffer
-static void DecompressBuffer(
-	const vector<uint8_t>& lzssStream,
-	vector<uint8_t>& out,
-	size_t originalSize,
+//Writes the entries of a block encoded by EncodeSolidBlock, the first entry carries the block.
+//Returns false if the archive could not be written
+static bool WriteSolidBlock(
+	ofstream& out,
+	const EncodedUnit& unit,
+	const string& target,
+	uint32_t& compCount,
+	uint32_t& rawCount,
+	uint32_t& emptyCount,
+	vector<DirectoryEntry>& directory);
+
+//Reads one block of a large file and compresses it, linked blocks also
+//read the end of the block before it as history. A failed read sets only the error of the unit
+static EncodedUnit EncodeFileBlock(
+	CompressContext& context,
+	const path& file,
+	const string& origin,
+	uint64_t block,
+	uint64_t fileSize);
+
+//Writes one block of a large file, the first block writes the entry with a placeholder
+//block table that the last block fills in. Returns false if the archive could not be written
+static bool WriteFileBlock(
+	ofstream& out,
+	const EncodedUnit& unit,
+	const CompressContext& context,
+	const CompressUnit& plan,
+	BlockedEntry& entry,
+	const string& target,
+	uint32_t& compCount,
+	uint32_t& rawCount,
+	vector<DirectoryEntry>& directory);
+
+//Bytes of the previous block every block of a large file starts with, 0 for independent blocks
+static uint32_t FileBlockHistorySize(const CompressContext& context);
+
+//Reads the block table at the start of a large file stored as blocks.
+//Returns false with the reason in outError instead of closing the program so it can run
+//on a worker, every helper that takes outError leaves reporting to the calling thread
+static bool ReadFileBlockTable(
+	ifstream& in,
+	uint64_t storedSize,
+	uint64_t originalSize,
+	const string& relPath,
+	const string& origin,
+	FileBlockTable& outTable,
+	string& outError);
+
+//Seeks to one block of a large file and decodes it into outBlock, checks its size
+static bool DecodeFileBlock(
+	ifstream& in,
+	const FileBlockTable& table,
+	size_t block,
+	uint64_t originalSize,
+	const vector<uint8_t>& history,
+	const string& relPath,
+	const string& origin,
+	vector<uint8_t>& outBlock,
+	string& outError);
+
+//Decodes a large file stored as blocks one block at a time straight into outPath, only one block
+//and the history of linked blocks are held in memory. Writes the checksum of the file to outChecksum
+static bool StreamBlockedFile(
+	ifstream& in,
+	uint64_t storedSize,
+	uint64_t originalSize,
+	const vector<uint8_t>& dictionary,
+	const path& outPath,
+	const string& relPath,
+	const string& origin,
+	const string& target,
+	uint32_t& outChecksum,
+	string& outError);
+
+//Reads the solid block that follows an entry into block
+static bool ReadSolidBlock(
+	ifstream& in,
+	uint64_t storedSize,
+	vector<uint8_t>& block,
+	const vector<uint8_t>& dictionary,
+	const string& relPath,
+	const string& origin,
+	string& outError);
+
+//Reads the magic and version at the start of an archive and checks them against
+//this build, then reads the entry count
+static bool ReadArchiveHeader(
+	ifstream& in,
+	const string& origin,
+	string& outMagicVer,
+	uint32_t& outEntryCount);
+
+//Appends the central directory of all entries and the fixed-size trailer that points to it
+static bool WriteDirectory(
+	ofstream& out,
+	CompressContext& context,
+	const vector<DirectoryEntry>& directory,
 	const string& target);
 
-//Recursively assign codes
-static void BuildCodes(
-	HuffNode* node,
-	const string& prefix,
-	map<uint8_t, string>& codes);
+//Reads the central directory through the trailer at the end of the archive and restores
+//the read position, every archive of this version ends with one
+static bool ReadDirectory(
+	ifstream& in,
+	const string& origin,
+	vector<DirectoryEntry>& directory);
 
-//Post-LZSS filter
-static vector<uint8_t> HuffmanEncode(
+//Seeks to the data of entry and decodes it into outData, checks its size and checksum.
+//Solid blocks are only decoded if cache doesn't already hold the block of entry
+static bool ReadDirectoryEntry(
+	ifstream& in,
+	const DirectoryEntry& entry,
+	const vector<uint8_t>& dictionary,
+	const string& origin,
+	SolidCache& cache,
+	vector<uint8_t>& outData,
+	string& outError);
+
+//Checks that relPath stays inside target and creates its parent directories,
+//writes the path of the file to outPath
+static bool CreateOutputPath(
+	const string& relPath,
+	const string& origin,
+	const string& target,
+	path& outPath);
+
+//Decodes one directory entry into outPath and checks it against its checksum,
+//large files stored as blocks are streamed to outPath block by block
+static bool ExtractDirectoryEntry(
+	ifstream& in,
+	const DirectoryEntry& entry,
+	const vector<uint8_t>& dictionary,
+	const path& outPath,
+	const string& origin,
+	const string& target,
+	SolidCache& cache,
+	string& outError);
+
+//Writes one decompressed file
+static bool WriteExtractedFile(
+	const path& outPath,
+	const vector<uint8_t>& data,
+	const string& relPath,
+	const string& origin,
+	const string& target,
+	string& outError);
+
+//Decodes directory entries first to last from in and writes them to outPaths,
+//stops at the first one that fails with its reason in outError
+static bool ExtractEntries(
+	ifstream& in,
+	const vector<DirectoryEntry>& directory,
+	size_t first,
+	size_t last,
+	const vector<path>& outPaths,
+	const vector<uint8_t>& dictionary,
+	const string& origin,
+	const string& target,
+	string& outError);
+
+//Decodes one independent block of a large file and writes it at its place in the
+//already sized output file, writes the checksum of the block to outChecksum
+static bool ExtractFileBlock(
+	ifstream& in,
+	const DirectoryEntry& entry,
+	const FileBlockTable& table,
+	size_t block,
+	const path& outPath,
+	const vector<uint8_t>& dictionary,
+	const string& origin,
+	const string& target,
+	uint32_t& outChecksum,
+	string& outError);
+
+//Decompresses every file of the central directory on threadCount workers, each with its own
+//reader on the archive, or in archive order on the calling thread if threadCount is 1. Files of one
+//solid block are decoded together, independent blocks of large files separately on more than one thread.
+//Output directories are created before the workers start so they never race
+static bool DecompressEntries(
+	const vector<DirectoryEntry>& directory,
+	const string& origin,
+	const string& target,
+	size_t threadCount,
+	uint32_t& compCount,
+	uint32_t& rawCount,
+	uint32_t& emptyCount,
+	uint32_t& dictionaryCount);
+
+//Verbose log line of one decompressed directory entry
+static void LogExtractedEntry(const DirectoryEntry& entry);
+
+//Name of a storage method for --contents
+static string MethodName(uint8_t method);
+
+//Checksum as 8 hex digits
+static string FormatChecksum(uint32_t checksum);
+
+//Compress a single buffer into an already open stream,
+//the tokens cover input from start, the bytes before it only prime the window.
+//If they are the dictionary of the run its cached match finder is used
+static vector<uint8_t> CompressBuffer(
+	CompressContext& context,
 	const vector<uint8_t>& input,
+	size_t start,
+	bool startsWithDictionary,
 	const string& origin);
 
-//Pre-LSZZ filter
-static vector<uint8_t> HuffmanDecode(
-	ifstream& in,
-	size_t storedSize,
+//Match finder over input whose first start bytes are the dictionary, the dictionary
+//is only added once per window size and cloned for every later buffer
+static unique_ptr<MatchFinder> CreatePrimedFinder(
+	CompressContext& context,
+	const vector<uint8_t>& input,
+	size_t start,
+	size_t windowSize);
+
+//Greedy or lazy LZSS parse, takes the longest match unless a longer one follows within lazyDepth bytes
+static bool ParseLazy(
+	const CompressContext& context,
+	const vector<uint8_t>& input,
+	size_t start,
+	MatchFinder& matchFinder,
+	const vector<LongMatch>& longMatches,
+	TokenWriter& writer,
 	const string& origin);
 
+//Price-based LZSS parse, picks the cheapest token path through each block
+//using the code lengths the split token streams would get from Huffman coding
+static void ParseOptimal(
+	const CompressContext& context,
+	const vector<uint8_t>& input,
+	size_t start,
+	MatchFinder& matchFinder,
+	const vector<LongMatch>& longMatches,
+	TokenWriter& writer);
+
+//Rest of the long-distance match that covers pos, up to limit. next follows the parser
+//through the position-sorted long matches. Writes its offset to outOffset, returns 0 if there is none
+static size_t FindLongMatch(
+	const vector<LongMatch>& longMatches,
+	size_t& next,
+	size_t pos,
+	size_t limit,
+	size_t& outOffset);
+
+//Longest match of at least MIN_MATCH at one of the repeat offsets, up to limit.
+//Writes its offset to outOffset, returns 0 if there is none
+static size_t FindRepMatch(
+	const vector<uint8_t>& input,
+	size_t pos,
+	const RepHistory& reps,
+	size_t limit,
+	size_t& outOffset);
+
+//Extends a match that reached the lookahead for as long as the data keeps repeating, up to limit
+static size_t ExtendMatch(
+	const vector<uint8_t>& input,
+	size_t pos,
+	size_t offset,
+	size_t length,
+	size_t limit);
+
+//Prices every symbol by its Huffman code length in freq,
+//unseen symbols cost one bit more than the rarest one and fallback without statistics
+static void BuildPrices(
+	const size_t freq[256],
+	uint32_t price[256],
+	uint32_t fallback);
+
 namespace KalaData
 {
 	void Compress::CompressToArchive(
@@ -180,10 +646,50 @@ namespace KalaData
 			return;
 		}
 
+		//solid blocks compress better when files of the same type sit next to each other,
+		//large and incompressible files go last so they don't split the blocks of small ones
+		size_t solidCount{};
+		if (SOLID_MODE)
+		{
+			sort(files.begin(), files.end(), [](const path& a, const path& b)
+				{
+					string extA = a.extension().string();
+					string extB = b.extension().string();
+
+					return extA != extB
+						? extA < extB
+						: a < b;
+				});
+
+			auto solidEnd = stable_partition(files.begin(), files.end(), [](const path& p)
+				{
+					return file_size(p) < SOLID_MAX_FILE_SIZE
+						&& !IsIncompressible(p);
+				});
+
+			solidCount = static_cast<size_t>(solidEnd - files.begin());
+		}
+
 		uint32_t compCount{};
 		uint32_t rawCount{};
 		uint32_t emptyCount{};
 
+		//workers only read this copy, the settings may change once the archive is done
+		CompressContext context{};
+		context.windowSize = WINDOW_SIZE;
+		context.lookAhead = LOOKAHEAD;
+		context.maxChain = MAX_CHAIN;
+		context.matchFinder = MATCH_FINDER;
+		context.lazyDepth = LAZY_DEPTH;
+		context.parser = PARSER;
+		context.entropyCoder = ENTROPY_CODER;
+		context.longMatchMemory = LONG_MATCH_MEMORY;
+		context.dictionary = DICTIONARY;
+		context.fileBlockSize = FILE_BLOCK_SIZE;
+		context.linkedBlocks = LINKED_BLOCKS;
+
+		size_t threadCount = ThreadPool::ResolveThreadCount(THREAD_COUNT);
+
 		const char magicVer[6] = { 'K', 'D', 'A', 'T', KALADATA_VERSION[9], KALADATA_VERSION[11] };
 		out.write(magicVer, sizeof(magicVer));
 
@@ -191,16 +697,63 @@ namespace KalaData
 		{
 			ostringstream ss{};
 
-			ss << "Window size is '" << WINDOW_SIZE << "'.\n"
-				<< "Lookahead is '" << LOOKAHEAD << "'.\n"
+			ss << "Window size is '" << context.windowSize << "'.\n"
+				<< "Lookahead is '" << context.lookAhead << "'.\n"
+				<< "Max chain is '" << context.maxChain << "'.\n"
+				<< "Match finder is '" << MatchFinderName(context.matchFinder) << "'.\n"
+				<< "Lazy depth is '" << context.lazyDepth << "'.\n"
+				<< "Parser is '" << ParserName(context.parser) << "'.\n"
+				<< "Entropy coder is '" << EntropyCoderName(context.entropyCoder) << "'.\n"
+				<< "Solid mode is '" << (SOLID_MODE ? "true" : "false") << "'.\n"
+				<< "Large file block size is '" << context.fileBlockSize << " bytes'.\n"
+				<< "Linked blocks is '" << (context.linkedBlocks ? "true" : "false") << "'.\n"
+				<< "Long-distance matcher memory is '" << context.longMatchMemory << " bytes'.\n"
+				<< "Dictionary size is '" << context.dictionary.size() << " bytes'.\n"
+				<< "Thread count is '" << threadCount << "'.\n"
 				<< "Min match is '" << MIN_MATCH << "'.\n\n"
 				<< "Archive '" + target + "' version will be '" + string(magicVer, 6) + "'.\n";
 
 			Core::PrintMessage(ss.str());
 		}
 
+		//the dictionary is stored once as the first entry
+		bool hasDictionary = !context.dictionary.empty();
+
+		//every entry gets a central directory record that --extract and --contents seek through
+		vector<DirectoryEntry> directory{};
+
 		uint32_t fileCount = (uint32_t)files.size();
-		out.write((char*)&fileCount, sizeof(uint32_t));
+		uint32_t entryCount = fileCount + (hasDictionary ? 1 : 0);
+		out.write((char*)&entryCount, sizeof(uint32_t));
+
+		if (hasDictionary)
+		{
+			uint32_t pathLen = 0;
+			uint8_t method = 6;
+			uint64_t dictionarySize = context.dictionary.size();
+
+			out.write((char*)&pathLen, sizeof(uint32_t));
+			out.write((char*)&method, sizeof(uint8_t));
+			out.write((char*)&dictionarySize, sizeof(uint64_t));
+			out.write((char*)&dictionarySize, sizeof(uint64_t));
+
+			directory.push_back({
+				"",
+				method,
+				dictionarySize,
+				dictionarySize,
+				0,
+				static_cast<uint64_t>(out.tellp()),
+				Checksum::Crc32(context.dictionary.data(), context.dictionary.size()) });
+
+			out.write((char*)context.dictionary.data(), context.dictionary.size());
+
+			if (Core::IsVerboseLoggingEnabled())
+			{
+				Core::PrintMessage(
+					"[DICTIONARY] '" + to_string(dictionarySize) + " bytes'");
+			}
+		}
 
 		if (!out.good())
 		{
@@ -211,106 +764,154 @@ namespace KalaData
 			return;
 		}
 
-		for (auto& file : files)
+		//files [first, last) of every unit of work, solid mode packs consecutive
+		//small compressible files into one block while they fit
+		vector<CompressUnit> units{};
+		for (size_t i = 0; i < files.size(); i++)
 		{
-			//relative path
-			string relPath = relative(file, origin).string();
-			uint32_t pathLen = (uint32_t)relPath.size();
-
-			//read file into memory
-			ifstream in(file, ios::binary);
-			vector<uint8_t> raw((istreambuf_iterator<char>(in)), {});
-			in.close();
-
-			//compress directly into memory
-			vector<uint8_t> lszzData = CompressBuffer(raw, relPath);
-
-			//wrap LZSS output with Huffman
-			vector<uint8_t> compData = HuffmanEncode(lszzData, origin);
-
-			uint64_t originalSize = raw.size();
-			uint64_t compressedSize = compData.size();
-
-			//safeguard: if compression is bigger or equal than original then store raw instead
-			bool useCompressed = compressedSize < originalSize;
-			const vector<uint8_t>& finalData = useCompressed ? compData : raw;
-			uint64_t finalSize = useCompressed ? compressedSize : originalSize;
+			size_t blockEnd = i + 1;
+			uint64_t fileSize = file_size(files[i]);
+
+			//large files are split into blocks that are encoded like separate files,
+			//so no file larger than one block is ever read into memory whole.
+			//The long-distance matcher only searches one buffer, so with it on files stay whole
+			if (fileSize > context.fileBlockSize
+				&& context.longMatchMemory == 0)
+			{
+				uint64_t blockCount = (fileSize + context.fileBlockSize - 1) / context.fileBlockSize;
+				for (uint64_t block = 0; block < blockCount; block++)
+				{
+					units.push_back({ i, blockEnd, block, blockCount, fileSize });
+				}
 
-			uint8_t method = useCompressed ? 1 : 0; //1 - LZSS, 0 = raw
+				continue;
+			}
 
-			if (!useCompressed)
+			//only the files before solidCount are small and compressible
+			if (i < solidCount)
 			{
-				if (originalSize == 0)
+				uint64_t blockSize = fileSize;
+
+				while (blockEnd < solidCount)
 				{
-					emptyCount++;
+					uint64_t nextSize = file_size(files[blockEnd]);
+					if (blockSize + nextSize > SOLID_BLOCK_SIZE) break;
 
-					if (Core::IsVerboseLoggingEnabled())
-					{
-						Core::PrintMessage(
-							"[EMPTY] '" + path(relPath).filename().string() + "'");
-					}
+					blockSize += nextSize;
+					blockEnd++;
 				}
-				else
-				{
-					rawCount++;
+			}
 
-					if (Core::IsVerboseLoggingEnabled())
-					{
-						ostringstream ss{};
+			//large files and files alone in their block are stored like in regular mode
+			units.push_back({ i, blockEnd, 0, 0, fileSize });
+			i = blockEnd - 1;
+		}
 
-						ss << "[RAW] '" << path(relPath).filename().string()
-							<< "' - '" << compressedSize << " bytes' "
-							<< ">= '" << originalSize << " bytes'";
+		//workers encode units ahead of the writer, which takes their results in
+		//archive order, so the archive is the same for every thread count.
+		//At most two units per thread wait in memory
+		ThreadPool pool(threadCount);
+		size_t maxInFlight = pool.GetThreadCount() * 2;
 
-						Core::PrintMessage(ss.str());
-					}
-				}
-			}
-			else
-			{
-				compCount++;
+		vector<future<EncodedUnit>> encoded(units.size());
 
-				if (Core::IsVerboseLoggingEnabled())
-				{
-					ostringstream ss{};
+		//blocks of a large file arrive one after another, this holds the file being written
+		BlockedEntry blockedEntry{};
+		size_t submitted = 0;
+
+		auto SubmitNext = [&]()
+			{
+				CompressUnit plan = units[submitted];
 
-					ss << "[COMPRESS] '" << path(relPath).filename().string()
-						<< "' - '" << compressedSize << " bytes' "
-						<< "< '" << originalSize << " bytes'";
+				auto task = make_shared<packaged_task<EncodedUnit()>>(
+					[&context, &files, &origin, plan]()
+					{
+						if (plan.blockCount > 0)
+						{
+							return EncodeFileBlock(
+								context,
+								files[plan.first],
+								origin,
+								plan.block,
+								plan.fileSize);
+						}
+
+						return plan.last - plan.first > 1
+							? EncodeSolidBlock(context, files, plan.first, plan.last, origin)
+							: EncodeFile(context, files[plan.first], origin, plan.fileSize);
+					});
+
+				encoded[submitted++] = task->get_future();
+				pool.Submit([task]() { (*task)(); });
+			};
 
-					Core::PrintMessage(ss.str());
-				}
+		for (size_t i = 0; i < units.size(); i++)
+		{
+			while (submitted < units.size()
+				&& submitted < i + maxInFlight)
+			{
+				SubmitNext();
 			}
 
-			//write metadata
-			out.write((char*)&pathLen, sizeof(uint32_t));
-			out.write(relPath.data(), pathLen);
-			out.write((char*)&method, sizeof(uint8_t));
-			out.write((char*)&originalSize, sizeof(uint64_t));
-			out.write((char*)&finalSize, sizeof(uint64_t));
+			EncodedUnit unit = encoded[i].get();
 
-			if (!out.good())
+			//a failed unit is reported once here, the workers never close the program
+			if (!unit.error.empty())
 			{
 				ForceClose(
-					"Failed to write metadata for file '" + relPath + "' while building archive '" + target + "'!\n",
+					unit.error,
 					ForceCloseType::TYPE_COMPRESSION);
 
 				return;
 			}
 
-			//write compressed data if it is more than 0 bytes
-			if (finalSize > 0)
+			if (units[i].blockCount > 0)
 			{
-				out.write((char*)finalData.data(), finalData.size());
-				if (!out.good())
+				if (!WriteFileBlock(
+					out,
+					unit,
+					context,
+					units[i],
+					blockedEntry,
+					target,
+					compCount,
+					rawCount,
+					directory))
 				{
-					ForceClose(
-						"Failed to write final data for file '" + relPath + "' while building archive '" + target + "'!\n",
-						ForceCloseType::TYPE_COMPRESSION);
-
 					return;
 				}
+
+				continue;
 			}
+
+			bool written = unit.relPaths.size() > 1
+				? WriteSolidBlock(
+					out,
+					unit,
+					target,
+					compCount,
+					rawCount,
+					emptyCount,
+					directory)
+				: WriteEntry(
+					out,
+					unit,
+					target,
+					compCount,
+					rawCount,
+					emptyCount,
+					directory);
+
+			if (!written) return;
+		}
+
+		if (!WriteDirectory(
+			out,
+			context,
+			directory,
+			target))
+		{
+			return;
 		}
 
 		//finished writing
@@ -396,46 +997,14 @@ namespace KalaData
 		uint32_t rawCount{};
 		uint32_t emptyCount{};
 
-		//read magic number
-		char magicVer[6]{};
-		in.read(magicVer, sizeof(magicVer));
-
-		//check magic
-		if (memcmp(magicVer, "KDAT", 4) != 0)
-		{
-			ForceClose(
-				"Invalid magic value in archive '" + origin + "'!\n",
-				ForceCloseType::TYPE_DECOMPRESSION);
-
-			return;
-		}
-
-		//check version range
-		int version = stoi(string(magicVer + 4, 2));
-		if (version < 1
-			|| version > 99)
-		{
-			ForceClose(
-				"Out of range version '" + to_string(version) + "' in archive '" + origin + "'!\n",
-				ForceCloseType::TYPE_DECOMPRESSION);
-
-			return;
-		}
-
-		//check version validity
-
-		char version_major = KALADATA_VERSION[9];
-		char version_minor = KALADATA_VERSION[11];
-
-		string thisVersion{ magicVer[4], magicVer[5] };
-		string requiredVersion{ version_major, version_minor };
-
-		if (thisVersion != requiredVersion)
+		string magicVer{};
+		uint32_t fileCount{};
+		if (!ReadArchiveHeader(
+			in,
+			origin,
+			magicVer,
+			fileCount))
 		{
-			ForceClose(
-				"Unsupported version '" + thisVersion + "' in archive '" + origin + "'! Version must be '" + requiredVersion + "'\n",
-				ForceCloseType::TYPE_DECOMPRESSION);
-
 			return;
 		}
 
@@ -446,223 +1015,48 @@ namespace KalaData
 			ss << "Window size is '" << WINDOW_SIZE << "'.\n"
 				<< "Lookahead is '" << LOOKAHEAD << "'.\n"
 				<< "Min match is '" << MIN_MATCH << "'.\n\n"
-				<< "Archive '" + target + "' version is '" + string(magicVer, 6) + "'.\n";
+				<< "Archive '" + target + "' version is '" + magicVer + "'.\n";
 
 			Core::PrintMessage(ss.str());
 		}
 
-		uint32_t fileCount{};
-		in.read((char*)&fileCount, sizeof(uint32_t));
-		if (fileCount > 100000)
+		//every file is checked against its checksum in the central directory
+		vector<DirectoryEntry> directory{};
+		if (!ReadDirectory(
+			in,
+			origin,
+			directory))
 		{
-			ForceClose(
-				"Archive '" + origin + "' reports an absurd file count (corrupted?)!\n",
-				ForceCloseType::TYPE_DECOMPRESSION);
-
 			return;
 		}
 
-		if (fileCount == 0)
+		if (directory.size() != fileCount)
 		{
 			ForceClose(
-				"Archive '" + origin + "' contains no valid files to decompress!\n",
+				"Central directory of archive '" + origin + "' does not match its entry count (corruption suspected)!\n",
 				ForceCloseType::TYPE_DECOMPRESSION);
 
 			return;
 		}
 
-		if (!in.good())
+		//the central directory lets every entry be read on its own,
+		//so files are decompressed on all threads
+		size_t threadCount = ThreadPool::ResolveThreadCount(THREAD_COUNT);
+		uint32_t dictionaryCount{};
+
+		if (!DecompressEntries(
+			directory,
+			origin,
+			target,
+			threadCount,
+			compCount,
+			rawCount,
+			emptyCount,
+			dictionaryCount))
 		{
-			ForceClose(
-				"Unexpected EOF while reading header data in archive '" + origin + "'!\n",
-				ForceCloseType::TYPE_DECOMPRESSION);
-
 			return;
 		}
 
-		for (uint32_t i = 0; i < fileCount; i++)
-		{
-			uint32_t pathLen{};
-			in.read((char*)&pathLen, sizeof(uint32_t));
-
-			string relPath(pathLen, '\0');
-			in.read(relPath.data(), pathLen);
-
-			uint8_t method{};
-			in.read((char*)&method, sizeof(uint8_t));
-
-			uint64_t originalSize{};
-			in.read((char*)&originalSize, sizeof(uint64_t));
-
-			uint64_t storedSize{};
-			in.read((char*)&storedSize, sizeof(uint64_t));
-
-			if (!in.good())
-			{
-				ForceClose(
-					"Unexpected EOF while reading metadata in archive '" + origin + "'!\n",
-					ForceCloseType::TYPE_DECOMPRESSION);
-
-				return;
-			}
-
-			if (method == 0)
-			{
-				if (storedSize != originalSize)
-				{
-					ostringstream ss{};
-
-					ss << "Stored size '" << storedSize << "' for raw file '" << relPath << "' "
-						<< "is not the same as original size '" << originalSize << "' "
-						<< "in archive '" << target << "' (corruption suspected)!\n";
-
-					ForceClose(
-						ss.str(),
-						ForceCloseType::TYPE_DECOMPRESSION);
-
-					return;
-				}
-			}
-			else if (method == 1)
-			{
-				if (storedSize >= originalSize)
-				{
-					ostringstream ss{};
-
-					ss << "Stored size '" << storedSize << "' for compressed file '" << relPath << "' "
-						<< "is the same or bigger than the original size '" << originalSize << "' "
-						<< "in archive '" << target << "' (corruption suspected)!\n";
-
-					ForceClose(
-						ss.str(),
-						ForceCloseType::TYPE_DECOMPRESSION);
-
-					return;
-				}
-			}
-			else
-			{
-				ForceClose(
-					"Unknown method storage flag '" + to_string(method) + "' in archive '" + origin + "'!\n",
-					ForceCloseType::TYPE_DECOMPRESSION);
-
-				return;
-			}
-
-			if (originalSize == 0) emptyCount++;
-			else if (storedSize < originalSize) compCount++;
-			else rawCount++;
-
-			path outPath = path(target) / relPath;
-			create_directories(outPath.parent_path());
-
-			//path traversal check
-			auto absTarget = weakly_canonical(target);
-			auto absOut = weakly_canonical(outPath);
-
-			if (absOut.string().find(absTarget.string()) != 0)
-			{
-				ForceClose(
-					"Archive '" + origin + "' contains invalid path '" + relPath + "' (path traveral attempt)!",
-					ForceCloseType::TYPE_DECOMPRESSION);
-
-				return;
-			}
-
-			//prepare output buffer
-			vector<uint8_t> data{};
-			auto storedStart = in.tellg();
-
-			//raw: copy exactly storedSize bytes
-			if (method == 0)
-			{
-				if (storedSize == 0
-					&& Core::IsVerboseLoggingEnabled())
-				{
-					Core::PrintMessage(
-						"[EMPTY] '" + path(relPath).filename().string() + "'");
-				}
-				else
-				{
-					if (Core::IsVerboseLoggingEnabled())
-					{
-						ostringstream ss{};
-
-						ss << "[RAW] '" << path(relPath).filename().string()
-							<< "' - '" << storedSize << " bytes' "
-							<< ">= '" << originalSize << " bytes'";
-
-						Core::PrintMessage(ss.str());
-					}
-
-					data.resize(static_cast<size_t>(storedSize));
-					if (!in.read((char*)data.data(), static_cast<streamsize>(storedSize)))
-					{
-						ForceClose(
-							"Unexpected end of archive while reading raw data for '" + relPath + "' in archive '" + origin + "'!\n",
-							ForceCloseType::TYPE_DECOMPRESSION);
-
-						return;
-					}
-				}
-			}
-			//LZSS: decompress storedSize to originalSize
-			else if (method == 1)
-			{
-				if (Core::IsVerboseLoggingEnabled())
-				{
-					ostringstream ss{};
-
-					ss << "[DECOMPRESS] '" << path(relPath).filename().string()
-						<< "' - '" << storedSize << " bytes' "
-						<< "< '" << originalSize << " bytes'";
-
-					Core::PrintMessage(ss.str());
-				}
-
-				vector<uint8_t> lzssStream = HuffmanDecode(
-					in,
-					static_cast<size_t>(storedSize),
-					origin);
-
-				//decompress
-				DecompressBuffer(
-					lzssStream,
-					data,
-					static_cast<size_t>(originalSize),
-					origin);
-			}
-
-			//sanity check
-			if (data.size() != originalSize)
-			{
-				ostringstream ss{};
-
-				ss << "Decompressed archive file '" << target << "' size '" << data.size()
-					<< "does not match original size '" << originalSize << "'!\n";
-
-				ForceClose(
-					ss.str(),
-					ForceCloseType::TYPE_DECOMPRESSION);
-
-				return;
-			}
-
-			//write file
-			ofstream outFile(outPath, ios::binary);
-			outFile.write((char*)data.data(), data.size());
-			if (!outFile.good())
-			{
-				ForceClose(
-					"Failed to extract file '" + relPath + "' from archive '" + origin + "' into target folder '" + target + "'!\n",
-					ForceCloseType::TYPE_DECOMPRESSION);
-				return;
-			}
-
-			//done writing
-			outFile.close();
-		}
-
 		//end timer
 		auto end = high_resolution_clock::now();
 		auto durationSec = duration<double>(end - start).count();
@@ -691,7 +1085,7 @@ namespace KalaData
 				<< "  - expansion ratio: " << fixed << setprecision(2) << ratio << "%\n"
 				<< "  - expansion factor: " << fixed << setprecision(2) << factor << "x\n"
 				<< "  - throughput: " << fixed << setprecision(2) << mbps << " MB/s\n"
-				<< "  - total files: " << fileCount << "\n"
+				<< "  - total files: " << fileCount - dictionaryCount << "\n"
 				<< "  - decompressed: " << compCount << "\n"
 				<< "  - unpacked raw: " << rawCount << "\n"
 				<< "  - empty: " << emptyCount << "\n"
@@ -714,19 +1108,231 @@ namespace KalaData
 
 		Command::SetCommandAllowState(true);
 	}
-}
-
-void ForceClose(
-	const string& message,
-	ForceCloseType type)
-{
-	string title{};
 
-	switch (type)
+	void Compress::ExtractFile(
+		const string& origin,
+		const string& entryPath,
+		const string& target)
 	{
-	case ForceCloseType::TYPE_COMPRESSION:
-		title = "Compression error";
-		break;
+		Command::SetCommandAllowState(false);
+
+		Core::PrintMessage(
+			"Starting to extract '" + entryPath + "' from archive '" + origin + "' to folder '" + target + "'!\n");
+
+		//start clock timer
+		auto start = high_resolution_clock::now();
+
+		ifstream in(origin, ios::binary);
+		if (!in.is_open())
+		{
+			ForceClose(
+				"Failed to open origin archive '" + origin + "'!\n",
+				ForceCloseType::TYPE_DECOMPRESSION);
+
+			return;
+		}
+
+		string magicVer{};
+		uint32_t entryCount{};
+		if (!ReadArchiveHeader(
+			in,
+			origin,
+			magicVer,
+			entryCount))
+		{
+			return;
+		}
+
+		vector<DirectoryEntry> directory{};
+		if (!ReadDirectory(
+			in,
+			origin,
+			directory))
+		{
+			return;
+		}
+
+		//paths are compared by their elements so either separator finds the file
+		path wantedPath = path(entryPath).lexically_normal();
+		const DirectoryEntry* entry{};
+		for (const auto& e : directory)
+		{
+			if (e.method != 6
+				&& path(e.relPath).lexically_normal() == wantedPath)
+			{
+				entry = &e;
+				break;
+			}
+		}
+
+		if (!entry)
+		{
+			Core::PrintMessage(
+				"Archive '" + origin + "' does not contain file '" + entryPath + "'! Type '--contents' to list its files.\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			Command::SetCommandAllowState(true);
+			return;
+		}
+
+		path outPath{};
+		if (!CreateOutputPath(
+			entry->relPath,
+			origin,
+			target,
+			outPath))
+		{
+			return;
+		}
+
+		//only the dictionary and the data of this one file are read
+		SolidCache cache{};
+		vector<uint8_t> dictionary{};
+		string error{};
+
+		if (directory.front().method == 6
+			&& entry->method != 0
+			&& !ReadDirectoryEntry(
+				in,
+				directory.front(),
+				{},
+				origin,
+				cache,
+				dictionary,
+				error))
+		{
+			ForceClose(
+				error,
+				ForceCloseType::TYPE_DECOMPRESSION);
+
+			return;
+		}
+
+		if (!ExtractDirectoryEntry(
+			in,
+			*entry,
+			dictionary,
+			outPath,
+			origin,
+			target,
+			cache,
+			error))
+		{
+			ForceClose(
+				error,
+				ForceCloseType::TYPE_DECOMPRESSION);
+
+			return;
+		}
+
+		//end timer
+		auto end = high_resolution_clock::now();
+		auto durationMs = duration<double>(end - start).count() * 1000.0;
+
+		ostringstream finishExtract{};
+
+		finishExtract
+			<< "Finished extracting '" << entry->relPath << "' from archive '"
+			<< path(origin).filename().string() << "' to folder '" << path(target).filename().string() << "'!\n"
+			<< "  - file size: " << entry->originalSize << " bytes\n"
+			<< "  - checksum: " << FormatChecksum(entry->checksum) << "\n"
+			<< "  - duration: " << fixed << setprecision(2) << durationMs << " ms\n";
+
+		Core::PrintMessage(
+			finishExtract.str(),
+			MessageType::MESSAGETYPE_SUCCESS);
+
+		Command::SetCommandAllowState(true);
+	}
+
+	void Compress::ListContents(const string& origin)
+	{
+		ifstream in(origin, ios::binary);
+		if (!in.is_open())
+		{
+			ForceClose(
+				"Failed to open origin archive '" + origin + "'!\n",
+				ForceCloseType::TYPE_DECOMPRESSION);
+
+			return;
+		}
+
+		string magicVer{};
+		uint32_t entryCount{};
+		if (!ReadArchiveHeader(
+			in,
+			origin,
+			magicVer,
+			entryCount))
+		{
+			return;
+		}
+
+		vector<DirectoryEntry> directory{};
+		if (!ReadDirectory(
+			in,
+			origin,
+			directory))
+		{
+			return;
+		}
+
+		ostringstream ss{};
+
+		ss << "Contents of archive '" << path(origin).filename().string() << "' (" << magicVer << "):\n\n"
+			<< left
+			<< "  " << setw(14) << "size"
+			<< setw(14) << "stored"
+			<< setw(12) << "method"
+			<< setw(10) << "checksum"
+			<< "path\n";
+
+		uint32_t fileCount{};
+		uint64_t totalSize{};
+
+		for (const auto& e : directory)
+		{
+			//solid files share the stored size of their block
+			string storedSize = e.method == 5
+				? "-"
+				: to_string(e.storedSize);
+			string relPath = e.method == 6
+				? "(dictionary)"
+				: e.relPath;
+
+			ss << "  " << setw(14) << e.originalSize
+				<< setw(14) << storedSize
+				<< setw(12) << MethodName(e.method)
+				<< setw(10) << FormatChecksum(e.checksum)
+				<< relPath << "\n";
+
+			if (e.method != 6)
+			{
+				fileCount++;
+				totalSize += e.originalSize;
+			}
+		}
+
+		ss << "\n"
+			<< "  - total files: " << fileCount << "\n"
+			<< "  - total size: " << totalSize << " bytes\n"
+			<< "  - archive size: " << file_size(origin) << " bytes\n";
+
+		Core::PrintMessage(ss.str());
+	}
+}
+
+void ForceClose(
+	const string& message,
+	ForceCloseType type)
+{
+	string title{};
+
+	switch (type)
+	{
+	case ForceCloseType::TYPE_COMPRESSION:
+		title = "Compression error";
+		break;
 	case ForceCloseType::TYPE_DECOMPRESSION:
 		title = "Decompression error";
 		break;
@@ -736,56 +1342,2152 @@ void ForceClose(
 	case ForceCloseType::TYPE_DECOMPRESSION_BUFFER:
 		title = "Decompression buffer error";
 		break;
-	case ForceCloseType::TYPE_HUFFMAN_ENCODE:
-		title = "Huffman encode error";
-		break;
-	case ForceCloseType::TYPE_HUFFMAN_DECODE:
-		title = "Huffman decode error";
-		break;
 	}
 
-	Core::ForceClose(title, message);
+	Core::ForceClose(title, message);
+}
+
+vector<uint8_t> EncodeBuffer(
+	CompressContext& context,
+	const vector<uint8_t>& raw,
+	const vector<uint8_t>& history,
+	const string& name,
+	const string& origin,
+	uint8_t& outMethod)
+{
+	//the history goes in front of the data, the tokens only cover the data but may match into it
+	vector<uint8_t> primed{};
+	if (!history.empty())
+	{
+		primed.reserve(history.size() + raw.size());
+		primed.insert(primed.end(), history.begin(), history.end());
+		primed.insert(primed.end(), raw.begin(), raw.end());
+	}
+	const vector<uint8_t>& input = history.empty() ? raw : primed;
+
+	vector<uint8_t> lzssData = CompressBuffer(
+		context,
+		input,
+		history.size(),
+		&history == &context.dictionary,
+		name);
+
+	if (context.entropyCoder == EntropyCoderType::ENTROPY_RANGE)
+	{
+		outMethod = 3;
+		return RangeCoder::Encode(
+			lzssData,
+			input,
+			history.size(),
+			origin);
+	}
+
+	//literals, lengths and offsets each get their own entropy table
+	outMethod = 4;
+	return TokenStreams::Encode(lzssData, origin);
+}
+
+vector<uint8_t> DecodeBuffer(
+	uint8_t method,
+	const vector<uint8_t>& stored,
+	size_t originalSize,
+	const vector<uint8_t>& history,
+	const string& origin,
+	string& outError)
+{
+	//both methods decode straight to the file
+	if (method == 3)
+	{
+		return RangeCoder::Decode(
+			stored.data(),
+			stored.size(),
+			originalSize,
+			history,
+			origin,
+			outError);
+	}
+
+	return TokenStreams::Decode(
+		stored.data(),
+		stored.size(),
+		originalSize,
+		history,
+		origin,
+		outError);
+}
+
+EncodedUnit EncodeFile(
+	CompressContext& context,
+	const path& file,
+	const string& origin,
+	uint64_t fileSize)
+{
+	EncodedUnit unit{};
+
+	//relative path
+	string relPath = relative(file, origin).string();
+
+	//read file into memory with one sized read, it is only larger than one block with the long-distance matcher
+	vector<uint8_t> raw(static_cast<size_t>(fileSize));
+
+	ifstream in(file, ios::binary);
+	if (!in.read((char*)raw.data(), static_cast<streamsize>(raw.size())))
+	{
+		unit.error = "Failed to read file '" + relPath + "', it may have changed during compression!\n";
+		return unit;
+	}
+	in.close();
+
+	//compress directly into memory
+	uint8_t compMethod{};
+	vector<uint8_t> compData = EncodeBuffer(
+		context,
+		raw,
+		context.dictionary,
+		relPath,
+		origin,
+		compMethod);
+
+	unit.relPaths.push_back(relPath);
+	unit.offsets = { 0, raw.size() };
+	unit.checksums.push_back(Checksum::Crc32(raw.data(), raw.size()));
+	unit.compressedSize = compData.size();
+
+	//safeguard: if compression is bigger or equal than original then store raw instead
+	bool useCompressed = compData.size() < raw.size();
+
+	unit.method = useCompressed ? compMethod : 0; //4 - LZSS split streams, 3 - LZSS + range coder, 0 - raw
+	unit.data = useCompressed ? move(compData) : move(raw);
+
+	return unit;
+}
+
+bool WriteEntry(
+	ofstream& out,
+	const EncodedUnit& unit,
+	const string& target,
+	uint32_t& compCount,
+	uint32_t& rawCount,
+	uint32_t& emptyCount,
+	vector<DirectoryEntry>& directory)
+{
+	const string& relPath = unit.relPaths.front();
+	uint32_t pathLen = (uint32_t)relPath.size();
+
+	uint8_t method = unit.method;
+	uint64_t originalSize = unit.offsets.back();
+	uint64_t compressedSize = unit.compressedSize;
+	uint64_t finalSize = unit.data.size();
+
+	if (method == 0)
+	{
+		if (originalSize == 0)
+		{
+			emptyCount++;
+
+			if (Core::IsVerboseLoggingEnabled())
+			{
+				Core::PrintMessage(
+					"[EMPTY] '" + path(relPath).filename().string() + "'");
+			}
+		}
+		else
+		{
+			rawCount++;
+
+			if (Core::IsVerboseLoggingEnabled())
+			{
+				ostringstream ss{};
+
+				ss << "[RAW] '" << path(relPath).filename().string()
+					<< "' - '" << compressedSize << " bytes' "
+					<< ">= '" << originalSize << " bytes'";
+
+				Core::PrintMessage(ss.str());
+			}
+		}
+	}
+	else
+	{
+		compCount++;
+
+		if (Core::IsVerboseLoggingEnabled())
+		{
+			ostringstream ss{};
+
+			ss << "[COMPRESS] '" << path(relPath).filename().string()
+				<< "' - '" << compressedSize << " bytes' "
+				<< "< '" << originalSize << " bytes'";
+
+			Core::PrintMessage(ss.str());
+		}
+	}
+
+	//write metadata
+	out.write((char*)&pathLen, sizeof(uint32_t));
+	out.write(relPath.data(), pathLen);
+	out.write((char*)&method, sizeof(uint8_t));
+	out.write((char*)&originalSize, sizeof(uint64_t));
+	out.write((char*)&finalSize, sizeof(uint64_t));
+
+	if (!out.good())
+	{
+		ForceClose(
+			"Failed to write metadata for file '" + relPath + "' while building archive '" + target + "'!\n",
+			ForceCloseType::TYPE_COMPRESSION);
+
+		return false;
+	}
+
+	directory.push_back({
+		relPath,
+		method,
+		originalSize,
+		finalSize,
+		0,
+		static_cast<uint64_t>(out.tellp()),
+		unit.checksums.front() });
+
+	//write compressed data if it is more than 0 bytes
+	if (finalSize > 0)
+	{
+		out.write((char*)unit.data.data(), unit.data.size());
+		if (!out.good())
+		{
+			ForceClose(
+				"Failed to write final data for file '" + relPath + "' while building archive '" + target + "'!\n",
+				ForceCloseType::TYPE_COMPRESSION);
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool IsIncompressible(const path& file)
+{
+	//formats that already carry their own compression
+	static const string compressedExtensions[] =
+	{
+		".7z", ".avif", ".br", ".bz2", ".docx", ".flac", ".gif", ".gz",
+		".jar", ".jpeg", ".jpg", ".kdat", ".lz4", ".mkv", ".mov", ".mp3",
+		".mp4", ".ogg", ".opus", ".png", ".rar", ".webm", ".webp", ".xlsx",
+		".xz", ".zip", ".zst"
+	};
+
+	string extension = file.extension().string();
+	transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c)
+		{
+			return static_cast<char>(tolower(c));
+		});
+
+	for (const string& compressed : compressedExtensions)
+	{
+		if (extension == compressed) return true;
+	}
+
+	vector<uint8_t> sample(static_cast<size_t>(min<uint64_t>(file_size(file), SOLID_PROBE_SIZE)));
+
+	//too few bytes to judge, tiny files gain the most from sharing a block
+	if (sample.size() < 256) return false;
+
+	ifstream in(file, ios::binary);
+	if (!in.read((char*)sample.data(), static_cast<streamsize>(sample.size()))) return false;
+
+	size_t freq[256]{};
+	for (uint8_t byte : sample) freq[byte]++;
+
+	//order-0 entropy of the sample, plus the bias of estimating it from
+	//few bytes (Miller-Madow) so that short random files still measure ~8 bits
+	double count = static_cast<double>(sample.size());
+	double bits = 0.0;
+	size_t used = 0;
+	for (size_t f : freq)
+	{
+		if (f == 0) continue;
+
+		double p = static_cast<double>(f) / count;
+		bits -= p * log2(p);
+		used++;
+	}
+	bits += static_cast<double>(used - 1) / (2.0 * count * log(2.0));
+
+	return bits > 7.8;
+}
+
+EncodedUnit EncodeSolidBlock(
+	CompressContext& context,
+	const vector<path>& files,
+	size_t first,
+	size_t last,
+	const string& origin)
+{
+	EncodedUnit unit{};
+
+	//the block is sized once from the file sizes, then every file is read into its slice
+	uint64_t blockSize = 0;
+	for (size_t i = first; i < last; i++)
+	{
+		unit.relPaths.push_back(relative(files[i], origin).string());
+		unit.offsets.push_back(blockSize);
+		blockSize += file_size(files[i]);
+	}
+	unit.offsets.push_back(blockSize);
+
+	vector<uint8_t> block(static_cast<size_t>(blockSize));
+
+	for (size_t i = 0; i < last - first; i++)
+	{
+		uint8_t* fileData = block.data() + unit.offsets[i];
+		size_t fileSize = static_cast<size_t>(unit.offsets[i + 1] - unit.offsets[i]);
+
+		ifstream in(files[first + i], ios::binary);
+		if (!in.read((char*)fileData, static_cast<streamsize>(fileSize)))
+		{
+			EncodedUnit failed{};
+			failed.error = "Failed to read file '" + unit.relPaths[i] + "', it may have changed during compression!\n";
+
+			return failed;
+		}
+		in.close();
+
+		unit.checksums.push_back(Checksum::Crc32(fileData, fileSize));
+	}
+
+	vector<uint8_t> compData = EncodeBuffer(
+		context,
+		block,
+		context.dictionary,
+		unit.relPaths.front(),
+		origin,
+		unit.method);
+
+	unit.compressedSize = compData.size();
+
+	//safeguard: the block is stored raw if compression doesn't make it smaller
+	bool useCompressed = compData.size() < block.size();
+	if (!useCompressed) unit.method = 0;
+
+	unit.data = useCompressed ? move(compData) : move(block);
+
+	return unit;
+}
+
+bool WriteSolidBlock(
+	ofstream& out,
+	const EncodedUnit& unit,
+	const string& target,
+	uint32_t& compCount,
+	uint32_t& rawCount,
+	uint32_t& emptyCount,
+	vector<DirectoryEntry>& directory)
+{
+	const vector<string>& relPaths = unit.relPaths;
+	const vector<uint64_t>& offsets = unit.offsets;
+
+	uint8_t blockMethod = unit.method;
+	bool useCompressed = blockMethod != 0;
+	uint64_t blockSize = offsets.back();
+
+	//block method and block size, then the block data
+	uint64_t blockStoredSize = sizeof(uint8_t) + sizeof(uint64_t) + unit.data.size();
+
+	if (Core::IsVerboseLoggingEnabled())
+	{
+		ostringstream ss{};
+
+		ss << "[BLOCK] '" << relPaths.size() << " files' - '"
+			<< unit.data.size() << " bytes' "
+			<< (useCompressed ? "< '" : ">= '") << blockSize << " bytes'";
+
+		Core::PrintMessage(ss.str());
+	}
+
+	streampos blockDataOffset{};
+
+	for (size_t i = 0; i < relPaths.size(); i++)
+	{
+		const string& relPath = relPaths[i];
+		uint32_t pathLen = (uint32_t)relPath.size();
+		uint8_t method = 5;
+		uint64_t originalSize = offsets[i + 1] - offsets[i];
+		uint64_t storedSize = i == 0 ? blockStoredSize : 0;
+		uint64_t blockOffset = offsets[i];
+
+		if (originalSize == 0) emptyCount++;
+		else if (useCompressed) compCount++;
+		else rawCount++;
+
+		if (Core::IsVerboseLoggingEnabled())
+		{
+			ostringstream ss{};
+
+			ss << "[SOLID] '" << path(relPath).filename().string()
+				<< "' - '" << originalSize << " bytes' "
+				<< "at block offset '" << blockOffset << "'";
+
+			Core::PrintMessage(ss.str());
+		}
+
+		//write metadata
+		out.write((char*)&pathLen, sizeof(uint32_t));
+		out.write(relPath.data(), pathLen);
+		out.write((char*)&method, sizeof(uint8_t));
+		out.write((char*)&originalSize, sizeof(uint64_t));
+		out.write((char*)&storedSize, sizeof(uint64_t));
+		out.write((char*)&blockOffset, sizeof(uint64_t));
+
+		//every file of the block points at the block data after the first entry
+		if (i == 0) blockDataOffset = out.tellp();
+
+		directory.push_back({
+			relPath,
+			method,
+			originalSize,
+			blockStoredSize,
+			blockOffset,
+			static_cast<uint64_t>(blockDataOffset),
+			unit.checksums[i] });
+
+		//the first entry carries the block
+		if (i == 0)
+		{
+			out.write((char*)&blockMethod, sizeof(uint8_t));
+			out.write((char*)&blockSize, sizeof(uint64_t));
+			out.write((char*)unit.data.data(), unit.data.size());
+		}
+
+		if (!out.good())
+		{
+			ForceClose(
+				"Failed to write solid block data for file '" + relPath + "' while building archive '" + target + "'!\n",
+				ForceCloseType::TYPE_COMPRESSION);
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+EncodedUnit EncodeFileBlock(
+	CompressContext& context,
+	const path& file,
+	const string& origin,
+	uint64_t block,
+	uint64_t fileSize)
+{
+	EncodedUnit unit{};
+
+	string relPath = relative(file, origin).string();
+
+	uint64_t blockStart = block * context.fileBlockSize;
+	uint64_t blockEnd = min(blockStart + context.fileBlockSize, fileSize);
+
+	//the first block and independent blocks start from the dictionary
+	uint64_t historySize = block > 0
+		? FileBlockHistorySize(context)
+		: 0;
+
+	vector<uint8_t> history(static_cast<size_t>(historySize));
+	vector<uint8_t> raw(static_cast<size_t>(blockEnd - blockStart));
+
+	ifstream in(file, ios::binary);
+	in.seekg(static_cast<streamoff>(blockStart - historySize));
+	in.read((char*)history.data(), static_cast<streamsize>(history.size()));
+	in.read((char*)raw.data(), static_cast<streamsize>(raw.size()));
+
+	if (!in.good())
+	{
+		unit.error = "Failed to read block '" + to_string(block) + "' of file '" + relPath + "', it may have changed during compression!\n";
+		return unit;
+	}
+	in.close();
+
+	uint8_t compMethod{};
+	vector<uint8_t> compData = EncodeBuffer(
+		context,
+		raw,
+		historySize > 0 ? history : context.dictionary,
+		relPath,
+		origin,
+		compMethod);
+
+	unit.relPaths.push_back(relPath);
+	unit.offsets = { blockStart, blockEnd };
+	unit.checksums.push_back(Checksum::Crc32(raw.data(), raw.size()));
+	unit.compressedSize = compData.size();
+
+	//safeguard: every block is stored raw on its own if compression doesn't make it smaller
+	bool useCompressed = compData.size() < raw.size();
+
+	unit.method = useCompressed ? compMethod : 0;
+	unit.data = useCompressed ? move(compData) : move(raw);
+
+	return unit;
+}
+
+bool WriteFileBlock(
+	ofstream& out,
+	const EncodedUnit& unit,
+	const CompressContext& context,
+	const CompressUnit& plan,
+	BlockedEntry& entry,
+	const string& target,
+	uint32_t& compCount,
+	uint32_t& rawCount,
+	vector<DirectoryEntry>& directory)
+{
+	const string& relPath = unit.relPaths.front();
+	uint64_t originalSize = plan.fileSize;
+
+	//the first block writes the entry and reserves room for the sizes only known at the end
+	if (plan.block == 0)
+	{
+		uint32_t pathLen = (uint32_t)relPath.size();
+		uint8_t method = 7;
+		uint64_t storedSize = 0;
+		uint64_t blockSize = context.fileBlockSize;
+		uint32_t historySize = FileBlockHistorySize(context);
+		uint32_t blockCount = (uint32_t)plan.blockCount;
+
+		out.write((char*)&pathLen, sizeof(uint32_t));
+		out.write(relPath.data(), pathLen);
+		out.write((char*)&method, sizeof(uint8_t));
+		out.write((char*)&originalSize, sizeof(uint64_t));
+
+		entry = {};
+		entry.storedSizePos = static_cast<uint64_t>(out.tellp());
+		out.write((char*)&storedSize, sizeof(uint64_t));
+
+		entry.tablePos = static_cast<uint64_t>(out.tellp());
+		out.write((char*)&blockSize, sizeof(uint64_t));
+		out.write((char*)&historySize, sizeof(uint32_t));
+		out.write((char*)&blockCount, sizeof(uint32_t));
+
+		vector<char> table(static_cast<size_t>(plan.blockCount * FILE_BLOCK_RECORD_SIZE));
+		out.write(table.data(), table.size());
+	}
+
+	out.write((char*)unit.data.data(), unit.data.size());
+
+	entry.methods.push_back(unit.method);
+	entry.storedSizes.push_back(unit.data.size());
+	entry.dataSize += unit.data.size();
+	entry.compressedSize += unit.compressedSize;
+	entry.checksum = plan.block == 0
+		? unit.checksums.front()
+		: Checksum::Combine(
+			entry.checksum,
+			unit.checksums.front(),
+			unit.offsets.back() - unit.offsets.front());
+
+	//the last block goes back to fill in the stored size and block table
+	if (plan.block + 1 == plan.blockCount)
+	{
+		uint64_t storedSize =
+			FILE_BLOCK_HEADER_SIZE
+			+ plan.blockCount * FILE_BLOCK_RECORD_SIZE
+			+ entry.dataSize;
+
+		streampos end = out.tellp();
+
+		out.seekp(static_cast<streamoff>(entry.storedSizePos));
+		out.write((char*)&storedSize, sizeof(uint64_t));
+
+		out.seekp(static_cast<streamoff>(entry.tablePos + FILE_BLOCK_HEADER_SIZE));
+		for (size_t i = 0; i < entry.methods.size(); i++)
+		{
+			out.write((char*)&entry.methods[i], sizeof(uint8_t));
+			out.write((char*)&entry.storedSizes[i], sizeof(uint64_t));
+		}
+
+		out.seekp(end);
+
+		bool useCompressed = storedSize < originalSize;
+		if (useCompressed) compCount++;
+		else rawCount++;
+
+		if (Core::IsVerboseLoggingEnabled())
+		{
+			ostringstream ss{};
+
+			ss << "[BLOCKS] '" << path(relPath).filename().string()
+				<< "' - '" << plan.blockCount << " blocks' - '"
+				<< entry.compressedSize << " bytes' "
+				<< (useCompressed ? "< '" : ">= '") << originalSize << " bytes'";
+
+			Core::PrintMessage(ss.str());
+		}
+
+		directory.push_back({
+			relPath,
+			7,
+			originalSize,
+			storedSize,
+			0,
+			entry.tablePos,
+			entry.checksum });
+	}
+
+	if (!out.good())
+	{
+		ForceClose(
+			"Failed to write block '" + to_string(plan.block) + "' of file '" + relPath + "' while building archive '" + target + "'!\n",
+			ForceCloseType::TYPE_COMPRESSION);
+
+		return false;
+	}
+
+	return true;
+}
+
+uint32_t FileBlockHistorySize(const CompressContext& context)
+{
+	if (!context.linkedBlocks) return 0;
+
+	//matches never reach further back than the window
+	return (uint32_t)min(context.windowSize, context.fileBlockSize);
+}
+
+bool ReadFileBlockTable(
+	ifstream& in,
+	uint64_t storedSize,
+	uint64_t originalSize,
+	const string& relPath,
+	const string& origin,
+	FileBlockTable& outTable,
+	string& outError)
+{
+	uint32_t blockCount{};
+
+	in.read((char*)&outTable.blockSize, sizeof(uint64_t));
+	in.read((char*)&outTable.historySize, sizeof(uint32_t));
+	in.read((char*)&blockCount, sizeof(uint32_t));
+
+	if (!in.good())
+	{
+		outError = "Unexpected end of archive while reading the block table of '" + relPath + "' in archive '" + origin + "'!\n";
+		return false;
+	}
+
+	uint64_t blockSize = outTable.blockSize;
+
+	if (blockSize == 0
+		|| blockSize > FILE_BLOCK_SIZE_MAX
+		|| outTable.historySize > blockSize
+		|| blockCount != (originalSize + blockSize - 1) / blockSize
+		|| storedSize < FILE_BLOCK_HEADER_SIZE + blockCount * FILE_BLOCK_RECORD_SIZE)
+	{
+		ostringstream ss{};
+
+		ss << "Invalid block table with block size '" << blockSize << "' and '" << blockCount
+			<< "' blocks for file '" << relPath << "' in archive '" << origin << "' (corruption suspected)!\n";
+
+		outError = ss.str();
+		return false;
+	}
+
+	outTable.methods.resize(blockCount);
+	outTable.storedSizes.resize(blockCount);
+	outTable.offsets.resize(blockCount);
+
+	for (uint32_t i = 0; i < blockCount; i++)
+	{
+		in.read((char*)&outTable.methods[i], sizeof(uint8_t));
+		in.read((char*)&outTable.storedSizes[i], sizeof(uint64_t));
+	}
+
+	if (!in.good())
+	{
+		outError = "Unexpected end of archive while reading the block table of '" + relPath + "' in archive '" + origin + "'!\n";
+		return false;
+	}
+
+	//blocks follow the table back to back
+	uint64_t offset = static_cast<uint64_t>(in.tellg());
+	uint64_t dataSize = storedSize - FILE_BLOCK_HEADER_SIZE - blockCount * FILE_BLOCK_RECORD_SIZE;
+
+	for (uint32_t i = 0; i < blockCount; i++)
+	{
+		if (outTable.storedSizes[i] > dataSize)
+		{
+			outError = "Blocks of file '" + relPath + "' are larger than its stored size in archive '" + origin + "' (corruption suspected)!\n";
+			return false;
+		}
+
+		outTable.offsets[i] = offset;
+		offset += outTable.storedSizes[i];
+		dataSize -= outTable.storedSizes[i];
+	}
+
+	if (dataSize != 0)
+	{
+		outError = "Blocks of file '" + relPath + "' don't add up to its stored size in archive '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	return true;
+}
+
+bool DecodeFileBlock(
+	ifstream& in,
+	const FileBlockTable& table,
+	size_t block,
+	uint64_t originalSize,
+	const vector<uint8_t>& history,
+	const string& relPath,
+	const string& origin,
+	vector<uint8_t>& outBlock,
+	string& outError)
+{
+	uint8_t method = table.methods[block];
+	uint64_t storedSize = table.storedSizes[block];
+	uint64_t blockStart = block * table.blockSize;
+	uint64_t blockSize = min(table.blockSize, originalSize - blockStart);
+
+	bool validMethod = method == 0
+		? storedSize == blockSize
+		: (method == 3 || method == 4) && storedSize < blockSize;
+
+	if (!validMethod)
+	{
+		ostringstream ss{};
+
+		ss << "Block '" << block << "' of file '" << relPath << "' has method '" << static_cast<int>(method)
+			<< "' with stored size '" << storedSize << "' for block size '" << blockSize
+			<< "' in archive '" << origin << "' (corruption suspected)!\n";
+
+		outError = ss.str();
+		return false;
+	}
+
+	in.clear();
+	in.seekg(static_cast<streamoff>(table.offsets[block]));
+
+	vector<uint8_t> stored(static_cast<size_t>(storedSize));
+	if (!in.read((char*)stored.data(), static_cast<streamsize>(storedSize)))
+	{
+		outError = "Unexpected end of archive while reading block '" + to_string(block) + "' of file '" + relPath + "' in archive '" + origin + "'!\n";
+		return false;
+	}
+
+	outBlock = method == 0
+		? move(stored)
+		: DecodeBuffer(
+			method,
+			stored,
+			static_cast<size_t>(blockSize),
+			history,
+			origin,
+			outError);
+
+	if (!outError.empty()) return false;
+
+	if (outBlock.size() != blockSize)
+	{
+		outError = "Decoded block '" + to_string(block) + "' of file '" + relPath + "' does not match its block size in archive '" + origin + "'!\n";
+		return false;
+	}
+
+	return true;
+}
+
+bool StreamBlockedFile(
+	ifstream& in,
+	uint64_t storedSize,
+	uint64_t originalSize,
+	const vector<uint8_t>& dictionary,
+	const path& outPath,
+	const string& relPath,
+	const string& origin,
+	const string& target,
+	uint32_t& outChecksum,
+	string& outError)
+{
+	FileBlockTable table{};
+	if (!ReadFileBlockTable(
+		in,
+		storedSize,
+		originalSize,
+		relPath,
+		origin,
+		table,
+		outError))
+	{
+		return false;
+	}
+
+	ofstream outFile(outPath, ios::binary);
+
+	vector<uint8_t> history{};
+	vector<uint8_t> block{};
+	outChecksum = 0;
+
+	for (size_t i = 0; i < table.methods.size(); i++)
+	{
+		//linked blocks match into the end of the block before them
+		bool linked = i > 0
+			&& table.historySize > 0;
+
+		if (!DecodeFileBlock(
+			in,
+			table,
+			i,
+			originalSize,
+			linked ? history : dictionary,
+			relPath,
+			origin,
+			block,
+			outError))
+		{
+			return false;
+		}
+
+		outChecksum = Checksum::Crc32(block.data(), block.size(), outChecksum);
+
+		outFile.write((char*)block.data(), block.size());
+		if (!outFile.good())
+		{
+			outError = "Failed to extract file '" + relPath + "' from archive '" + origin + "' into target folder '" + target + "'!\n";
+			return false;
+		}
+
+		if (table.historySize > 0
+			&& i + 1 < table.methods.size())
+		{
+			history.assign(block.end() - table.historySize, block.end());
+		}
+	}
+
+	return true;
+}
+
+bool ReadSolidBlock(
+	ifstream& in,
+	uint64_t storedSize,
+	vector<uint8_t>& block,
+	const vector<uint8_t>& dictionary,
+	const string& relPath,
+	const string& origin,
+	string& outError)
+{
+	uint8_t blockMethod{};
+	uint64_t blockSize{};
+
+	in.read((char*)&blockMethod, sizeof(uint8_t));
+	in.read((char*)&blockSize, sizeof(uint64_t));
+
+	if (!in.good()
+		|| storedSize < sizeof(uint8_t) + sizeof(uint64_t))
+	{
+		outError = "Unexpected end of archive while reading solid block header for '" + relPath + "' in archive '" + origin + "'!\n";
+		return false;
+	}
+
+	uint64_t dataSize = storedSize - sizeof(uint8_t) - sizeof(uint64_t);
+
+	bool validMethod = blockMethod == 0
+		? dataSize == blockSize
+		: (blockMethod == 3 || blockMethod == 4) && dataSize < blockSize;
+
+	if (!validMethod)
+	{
+		ostringstream ss{};
+
+		ss << "Solid block of '" << relPath << "' has method '" << static_cast<int>(blockMethod)
+			<< "' with stored size '" << dataSize << "' for block size '" << blockSize
+			<< "' in archive '" << origin << "' (corruption suspected)!\n";
+
+		outError = ss.str();
+		return false;
+	}
+
+	vector<uint8_t> stored(static_cast<size_t>(dataSize));
+	if (!in.read((char*)stored.data(), static_cast<streamsize>(dataSize)))
+	{
+		outError = "Unexpected end of archive while reading solid block for '" + relPath + "' in archive '" + origin + "'!\n";
+		return false;
+	}
+
+	block = blockMethod == 0
+		? move(stored)
+		: DecodeBuffer(
+			blockMethod,
+			stored,
+			static_cast<size_t>(blockSize),
+			dictionary,
+			origin,
+			outError);
+
+	if (!outError.empty()) return false;
+
+	if (block.size() != blockSize)
+	{
+		outError = "Decoded solid block of '" + relPath + "' does not match its block size in archive '" + origin + "'!\n";
+		return false;
+	}
+
+	return true;
+}
+
+bool ReadArchiveHeader(
+	ifstream& in,
+	const string& origin,
+	string& outMagicVer,
+	uint32_t& outEntryCount)
+{
+	//read magic number
+	char magicVer[6]{};
+	in.read(magicVer, sizeof(magicVer));
+
+	//check magic
+	if (memcmp(magicVer, "KDAT", 4) != 0)
+	{
+		ForceClose(
+			"Invalid magic value in archive '" + origin + "'!\n",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	//check version range
+	int version = stoi(string(magicVer + 4, 2));
+	if (version < 1
+		|| version > 99)
+	{
+		ForceClose(
+			"Out of range version '" + to_string(version) + "' in archive '" + origin + "'!\n",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	//check version validity
+
+	char version_major = KALADATA_VERSION[9];
+	char version_minor = KALADATA_VERSION[11];
+
+	string thisVersion{ magicVer[4], magicVer[5] };
+	string requiredVersion{ version_major, version_minor };
+
+	if (thisVersion != requiredVersion)
+	{
+		ForceClose(
+			"Unsupported version '" + thisVersion + "' in archive '" + origin + "'! Version must be '" + requiredVersion + "'\n",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	in.read((char*)&outEntryCount, sizeof(uint32_t));
+	if (outEntryCount > MAX_ENTRY_COUNT)
+	{
+		ForceClose(
+			"Archive '" + origin + "' reports an absurd file count (corrupted?)!\n",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	if (outEntryCount == 0)
+	{
+		ForceClose(
+			"Archive '" + origin + "' contains no valid files to decompress!\n",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	if (!in.good())
+	{
+		ForceClose(
+			"Unexpected EOF while reading header data in archive '" + origin + "'!\n",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	outMagicVer = string(magicVer, sizeof(magicVer));
+
+	return true;
+}
+
+bool WriteDirectory(
+	ofstream& out,
+	CompressContext& context,
+	const vector<DirectoryEntry>& directory,
+	const string& target)
+{
+	vector<uint8_t> data{};
+
+	auto Append = [&data](const void* value, size_t size)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(value);
+			data.insert(data.end(), bytes, bytes + size);
+		};
+
+	for (const auto& entry : directory)
+	{
+		uint32_t pathLen = (uint32_t)entry.relPath.size();
+
+		Append(&pathLen, sizeof(uint32_t));
+		Append(entry.relPath.data(), pathLen);
+		Append(&entry.method, sizeof(uint8_t));
+		Append(&entry.originalSize, sizeof(uint64_t));
+		Append(&entry.storedSize, sizeof(uint64_t));
+		Append(&entry.blockOffset, sizeof(uint64_t));
+		Append(&entry.dataOffset, sizeof(uint64_t));
+		Append(&entry.checksum, sizeof(uint32_t));
+	}
+
+	//paths of neighbouring files share most of their bytes, so the directory
+	//is stored as split token streams unless that doesn't make it smaller
+	vector<uint8_t> compData = TokenStreams::Encode(
+		CompressBuffer(context, data, 0, false, target),
+		target);
+
+	bool useCompressed = compData.size() < data.size();
+	const vector<uint8_t>& finalData = useCompressed ? compData : data;
+
+	uint64_t directoryOffset = static_cast<uint64_t>(out.tellp());
+	uint64_t storedSize = finalData.size();
+	uint64_t originalSize = data.size();
+	uint32_t entryCount = (uint32_t)directory.size();
+	uint32_t directoryChecksum = Checksum::Crc32(data.data(), data.size());
+	uint16_t directoryMethod = useCompressed ? 4 : 0;
+	uint16_t directoryVersion = DIRECTORY_VERSION;
+
+	out.write((char*)finalData.data(), finalData.size());
+
+	//fixed-size trailer, readers find the directory from the end of the archive
+	out.write((char*)&directoryOffset, sizeof(uint64_t));
+	out.write((char*)&storedSize, sizeof(uint64_t));
+	out.write((char*)&originalSize, sizeof(uint64_t));
+	out.write((char*)&entryCount, sizeof(uint32_t));
+	out.write((char*)&directoryChecksum, sizeof(uint32_t));
+	out.write((char*)&directoryMethod, sizeof(uint16_t));
+	out.write((char*)&directoryVersion, sizeof(uint16_t));
+	out.write(DIRECTORY_MAGIC, sizeof(DIRECTORY_MAGIC));
+
+	if (!out.good())
+	{
+		ForceClose(
+			"Failed to write central directory while building archive '" + target + "'!\n",
+			ForceCloseType::TYPE_COMPRESSION);
+
+		return false;
+	}
+
+	return true;
+}
+
+bool ReadDirectory(
+	ifstream& in,
+	const string& origin,
+	vector<DirectoryEntry>& directory)
+{
+	streampos readPos = in.tellg();
+
+	in.seekg(0, ios::end);
+	uint64_t archiveSize = static_cast<uint64_t>(in.tellg());
+
+	//magic, version and entry count come before any directory
+	uint64_t headerSize = 6 + sizeof(uint32_t);
+
+	uint8_t trailer[DIRECTORY_TRAILER_SIZE]{};
+	if (archiveSize >= headerSize + DIRECTORY_TRAILER_SIZE)
+	{
+		in.seekg(static_cast<streamoff>(archiveSize - DIRECTORY_TRAILER_SIZE));
+		in.read((char*)trailer, DIRECTORY_TRAILER_SIZE);
+	}
+
+	if (!in.good()
+		|| memcmp(trailer + DIRECTORY_TRAILER_SIZE - sizeof(DIRECTORY_MAGIC), DIRECTORY_MAGIC, sizeof(DIRECTORY_MAGIC)) != 0)
+	{
+		ForceClose(
+			"Archive '" + origin + "' has no central directory (truncated or corrupted)!\n",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	uint64_t directoryOffset{};
+	uint64_t storedSize{};
+	uint64_t originalSize{};
+	uint32_t entryCount{};
+	uint32_t directoryChecksum{};
+	uint16_t directoryMethod{};
+	uint16_t directoryVersion{};
+
+	memcpy(&directoryOffset, trailer, sizeof(uint64_t));
+	memcpy(&storedSize, trailer + 8, sizeof(uint64_t));
+	memcpy(&originalSize, trailer + 16, sizeof(uint64_t));
+	memcpy(&entryCount, trailer + 24, sizeof(uint32_t));
+	memcpy(&directoryChecksum, trailer + 28, sizeof(uint32_t));
+	memcpy(&directoryMethod, trailer + 32, sizeof(uint16_t));
+	memcpy(&directoryVersion, trailer + 34, sizeof(uint16_t));
+
+	if (directoryVersion != DIRECTORY_VERSION)
+	{
+		ForceClose(
+			"Unsupported central directory version '" + to_string(directoryVersion) + "' in archive '" + origin + "'! Version must be '" + to_string(DIRECTORY_VERSION) + "'\n",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	//the directory sits between the last entry and the trailer
+	uint64_t directoryEnd = archiveSize - DIRECTORY_TRAILER_SIZE;
+	bool validMethod = directoryMethod == 0
+		? storedSize == originalSize
+		: directoryMethod == 4 && storedSize < originalSize;
+
+	if (directoryOffset < headerSize
+		|| directoryOffset > directoryEnd
+		|| storedSize != directoryEnd - directoryOffset
+		|| !validMethod
+		|| entryCount > MAX_ENTRY_COUNT
+		|| originalSize > entryCount * (DIRECTORY_RECORD_SIZE + DIRECTORY_MAX_PATH))
+	{
+		ForceClose(
+			"Central directory trailer of archive '" + origin + "' points outside of the archive (corruption suspected)!\n",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	vector<uint8_t> stored(static_cast<size_t>(storedSize));
+	in.seekg(static_cast<streamoff>(directoryOffset));
+	if (!in.read((char*)stored.data(), static_cast<streamsize>(storedSize)))
+	{
+		ForceClose(
+			"Unexpected end of archive while reading the central directory of archive '" + origin + "'!\n",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	string error{};
+	vector<uint8_t> data = directoryMethod == 0
+		? move(stored)
+		: TokenStreams::Decode(
+			stored.data(),
+			stored.size(),
+			static_cast<size_t>(originalSize),
+			{},
+			origin,
+			error);
+
+	if (!error.empty())
+	{
+		ForceClose(
+			error,
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	if (Checksum::Crc32(data.data(), data.size()) != directoryChecksum)
+	{
+		ForceClose(
+			"Central directory checksum mismatch in archive '" + origin + "' (corruption suspected)!\n",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	size_t pos = 0;
+	auto Read = [&data, &pos](void* value, size_t size)
+		{
+			if (size > data.size() - pos) return false;
+
+			memcpy(value, data.data() + pos, size);
+			pos += size;
+
+			return true;
+		};
+
+	directory.clear();
+	directory.reserve(entryCount);
+
+	for (uint32_t i = 0; i < entryCount; i++)
+	{
+		DirectoryEntry entry{};
+		uint32_t pathLen{};
+
+		bool valid = Read(&pathLen, sizeof(uint32_t))
+			&& pathLen <= data.size() - pos;
+
+		if (valid)
+		{
+			entry.relPath.assign((const char*)data.data() + pos, pathLen);
+			pos += pathLen;
+
+			valid = Read(&entry.method, sizeof(uint8_t))
+				&& Read(&entry.originalSize, sizeof(uint64_t))
+				&& Read(&entry.storedSize, sizeof(uint64_t))
+				&& Read(&entry.blockOffset, sizeof(uint64_t))
+				&& Read(&entry.dataOffset, sizeof(uint64_t))
+				&& Read(&entry.checksum, sizeof(uint32_t));
+		}
+
+		//stored data must lie between the header and the directory
+		if (!valid
+			|| entry.dataOffset < headerSize
+			|| entry.dataOffset > directoryOffset
+			|| entry.storedSize > directoryOffset - entry.dataOffset)
+		{
+			ForceClose(
+				"Invalid central directory entry '" + to_string(i) + "' in archive '" + origin + "' (corruption suspected)!\n",
+				ForceCloseType::TYPE_DECOMPRESSION);
+
+			return false;
+		}
+
+		directory.push_back(move(entry));
+	}
+
+	if (pos != data.size())
+	{
+		ForceClose(
+			"Central directory of archive '" + origin + "' has trailing data (corruption suspected)!\n",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	in.clear();
+	in.seekg(readPos);
+
+	return true;
+}
+
+bool ReadDirectoryEntry(
+	ifstream& in,
+	const DirectoryEntry& entry,
+	const vector<uint8_t>& dictionary,
+	const string& origin,
+	SolidCache& cache,
+	vector<uint8_t>& outData,
+	string& outError)
+{
+	const string& relPath = entry.relPath;
+
+	in.clear();
+	in.seekg(static_cast<streamoff>(entry.dataOffset));
+
+	//raw files and the dictionary are stored as they are
+	if (entry.method == 0
+		|| entry.method == 6)
+	{
+		if (entry.storedSize != entry.originalSize)
+		{
+			outError = "Stored size of raw file '" + relPath + "' is not the same as its original size in archive '" + origin + "' (corruption suspected)!\n";
+			return false;
+		}
+
+		outData.resize(static_cast<size_t>(entry.storedSize));
+		if (!in.read((char*)outData.data(), static_cast<streamsize>(entry.storedSize)))
+		{
+			outError = "Unexpected end of archive while reading raw data for '" + relPath + "' in archive '" + origin + "'!\n";
+			return false;
+		}
+	}
+	else if (entry.method == 3
+		|| entry.method == 4)
+	{
+		if (entry.storedSize >= entry.originalSize)
+		{
+			outError = "Stored size of compressed file '" + relPath + "' is the same or bigger than its original size in archive '" + origin + "' (corruption suspected)!\n";
+			return false;
+		}
+
+		vector<uint8_t> stored(static_cast<size_t>(entry.storedSize));
+		if (!in.read((char*)stored.data(), static_cast<streamsize>(entry.storedSize)))
+		{
+			outError = "Unexpected end of archive while reading compressed data for '" + relPath + "' in archive '" + origin + "'!\n";
+			return false;
+		}
+
+		outData = DecodeBuffer(
+			entry.method,
+			stored,
+			static_cast<size_t>(entry.originalSize),
+			dictionary,
+			origin,
+			outError);
+
+		if (!outError.empty()) return false;
+	}
+	//solid files are cut out of their decoded block
+	else if (entry.method == 5)
+	{
+		if (cache.dataOffset != entry.dataOffset)
+		{
+			cache.dataOffset = UINT64_MAX;
+
+			if (!ReadSolidBlock(
+				in,
+				entry.storedSize,
+				cache.block,
+				dictionary,
+				relPath,
+				origin,
+				outError))
+			{
+				return false;
+			}
+
+			cache.dataOffset = entry.dataOffset;
+		}
+
+		const vector<uint8_t>& block = cache.block;
+
+		if (entry.blockOffset > block.size()
+			|| entry.originalSize > block.size() - entry.blockOffset)
+		{
+			outError = "Solid file '" + relPath + "' is outside of its block in archive '" + origin + "' (corruption suspected)!\n";
+			return false;
+		}
+
+		const uint8_t* blockStart = block.data() + entry.blockOffset;
+		outData.assign(blockStart, blockStart + entry.originalSize);
+	}
+	else
+	{
+		outError = "Unknown method storage flag '" + to_string(entry.method) + "' in archive '" + origin + "'!\n";
+		return false;
+	}
+
+	if (outData.size() != entry.originalSize)
+	{
+		outError = "Decompressed file '" + relPath + "' does not match its original size in archive '" + origin + "'!\n";
+		return false;
+	}
+
+	if (Checksum::Crc32(outData.data(), outData.size()) != entry.checksum)
+	{
+		outError = "Checksum mismatch for file '" + relPath + "' in archive '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	return true;
+}
+
+bool CreateOutputPath(
+	const string& relPath,
+	const string& origin,
+	const string& target,
+	path& outPath)
+{
+	outPath = path(target) / relPath;
+	create_directories(outPath.parent_path());
+
+	//path traversal check
+	auto absTarget = weakly_canonical(target);
+	auto absOut = weakly_canonical(outPath);
+
+	if (absOut.string().find(absTarget.string()) != 0)
+	{
+		ForceClose(
+			"Archive '" + origin + "' contains invalid path '" + relPath + "' (path traveral attempt)!",
+			ForceCloseType::TYPE_DECOMPRESSION);
+
+		return false;
+	}
+
+	return true;
+}
+
+bool ExtractDirectoryEntry(
+	ifstream& in,
+	const DirectoryEntry& entry,
+	const vector<uint8_t>& dictionary,
+	const path& outPath,
+	const string& origin,
+	const string& target,
+	SolidCache& cache,
+	string& outError)
+{
+	if (entry.method == 7)
+	{
+		in.clear();
+		in.seekg(static_cast<streamoff>(entry.dataOffset));
+
+		uint32_t checksum{};
+		if (!StreamBlockedFile(
+			in,
+			entry.storedSize,
+			entry.originalSize,
+			dictionary,
+			outPath,
+			entry.relPath,
+			origin,
+			target,
+			checksum,
+			outError))
+		{
+			return false;
+		}
+
+		if (checksum != entry.checksum)
+		{
+			outError = "Checksum mismatch for file '" + entry.relPath + "' in archive '" + origin + "' (corruption suspected)!\n";
+			return false;
+		}
+
+		return true;
+	}
+
+	vector<uint8_t> data{};
+	if (!ReadDirectoryEntry(
+		in,
+		entry,
+		dictionary,
+		origin,
+		cache,
+		data,
+		outError))
+	{
+		return false;
+	}
+
+	return WriteExtractedFile(
+		outPath,
+		data,
+		entry.relPath,
+		origin,
+		target,
+		outError);
+}
+
+bool WriteExtractedFile(
+	const path& outPath,
+	const vector<uint8_t>& data,
+	const string& relPath,
+	const string& origin,
+	const string& target,
+	string& outError)
+{
+	ofstream outFile(outPath, ios::binary);
+	outFile.write((char*)data.data(), data.size());
+	if (!outFile.good())
+	{
+		outError = "Failed to extract file '" + relPath + "' from archive '" + origin + "' into target folder '" + target + "'!\n";
+		return false;
+	}
+
+	return true;
+}
+
+bool ExtractEntries(
+	ifstream& in,
+	const vector<DirectoryEntry>& directory,
+	size_t first,
+	size_t last,
+	const vector<path>& outPaths,
+	const vector<uint8_t>& dictionary,
+	const string& origin,
+	const string& target,
+	string& outError)
+{
+	//every file of a solid block is cut out of the same decoded block
+	SolidCache cache{};
+
+	for (size_t i = first; i < last; i++)
+	{
+		if (!ExtractDirectoryEntry(
+			in,
+			directory[i],
+			dictionary,
+			outPaths[i],
+			origin,
+			target,
+			cache,
+			outError))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool DecompressEntries(
+	const vector<DirectoryEntry>& directory,
+	const string& origin,
+	const string& target,
+	size_t threadCount,
+	uint32_t& compCount,
+	uint32_t& rawCount,
+	uint32_t& emptyCount,
+	uint32_t& dictionaryCount)
+{
+	//each worker seeks and reads through its own stream, the first one also reads the dictionary
+	vector<ifstream> readers(threadCount);
+	for (auto& reader : readers)
+	{
+		reader.open(origin, ios::binary);
+		if (!reader.is_open())
+		{
+			ForceClose(
+				"Failed to open origin archive '" + origin + "'!\n",
+				ForceCloseType::TYPE_DECOMPRESSION);
+
+			return false;
+		}
+	}
+
+	size_t firstFile = 0;
+	vector<uint8_t> dictionary{};
+	if (!directory.empty()
+		&& directory.front().method == 6)
+	{
+		const DirectoryEntry& entry = directory.front();
+
+		if (entry.originalSize == 0
+			|| entry.originalSize > DICTIONARY_MAX_SIZE)
+		{
+			ostringstream ss{};
+
+			ss << "Invalid dictionary entry with size '" << entry.originalSize
+				<< "' in archive '" << origin << "' (corruption suspected)!\n";
+
+			ForceClose(
+				ss.str(),
+				ForceCloseType::TYPE_DECOMPRESSION);
+
+			return false;
+		}
+
+		SolidCache cache{};
+		string error{};
+		if (!ReadDirectoryEntry(
+			readers.front(),
+			entry,
+			{},
+			origin,
+			cache,
+			dictionary,
+			error))
+		{
+			ForceClose(
+				error,
+				ForceCloseType::TYPE_DECOMPRESSION);
+
+			return false;
+		}
+
+		LogExtractedEntry(entry);
+
+		dictionaryCount++;
+		firstFile = 1;
+	}
+
+	//every directory is created and every path checked before the workers start,
+	//workers only ever open the files of their own entries
+	vector<path> outPaths(directory.size());
+	for (size_t i = firstFile; i < directory.size(); i++)
+	{
+		const DirectoryEntry& entry = directory[i];
+
+		if (entry.method == 6)
+		{
+			ForceClose(
+				"Dictionary entry '" + to_string(i) + "' is not the first entry in archive '" + origin + "' (corruption suspected)!\n",
+				ForceCloseType::TYPE_DECOMPRESSION);
+
+			return false;
+		}
+
+		if (!CreateOutputPath(
+			entry.relPath,
+			origin,
+			target,
+			outPaths[i]))
+		{
+			return false;
+		}
+	}
+
+	//one unit per file, the files of a solid block stay together so it is decoded once.
+	//With more than one thread large files with independent blocks get one unit per block,
+	//their tables are read here and their files are created at full size so every block can be
+	//written in place. A single thread streams them block by block like every other file
+	vector<ExtractUnit> units{};
+	vector<FileBlockTable> tables(directory.size());
+	vector<vector<uint32_t>> blockChecksums(directory.size());
+
+	for (size_t i = firstFile; i < directory.size(); i++)
+	{
+		size_t unitEnd = i + 1;
+
+		if (directory[i].method == 7
+			&& threadCount > 1)
+		{
+			const DirectoryEntry& entry = directory[i];
+			FileBlockTable& table = tables[i];
+
+			ifstream& in = readers.front();
+			in.clear();
+			in.seekg(static_cast<streamoff>(entry.dataOffset));
+
+			string error{};
+			if (!ReadFileBlockTable(
+				in,
+				entry.storedSize,
+				entry.originalSize,
+				entry.relPath,
+				origin,
+				table,
+				error))
+			{
+				ForceClose(
+					error,
+					ForceCloseType::TYPE_DECOMPRESSION);
+
+				return false;
+			}
+
+			size_t blockCount = table.methods.size();
+			if (table.historySize == 0
+				&& blockCount > 1)
+			{
+				ofstream outFile(outPaths[i], ios::binary);
+				outFile.close();
+				resize_file(outPaths[i], entry.originalSize);
+
+				blockChecksums[i].resize(blockCount);
+
+				for (size_t block = 0; block < blockCount; block++)
+				{
+					units.push_back({ i, unitEnd, block });
+				}
+
+				continue;
+			}
+		}
+
+		if (directory[i].method == 5)
+		{
+			while (unitEnd < directory.size()
+				&& directory[unitEnd].method == 5
+				&& directory[unitEnd].dataOffset == directory[i].dataOffset)
+			{
+				unitEnd++;
+			}
+		}
+
+		units.push_back({ i, unitEnd, SIZE_MAX });
+		i = unitEnd - 1;
+	}
+
+	//a finished unit is counted and logged, a file split into blocks is done with
+	//its last block and its checksum is put together from theirs
+	auto FinishUnit = [&](const ExtractUnit& unit)
+		{
+			auto [first, last, block] = unit;
+
+			if (block != SIZE_MAX)
+			{
+				const vector<uint32_t>& checksums = blockChecksums[first];
+				if (block + 1 < checksums.size()) return true;
+
+				const FileBlockTable& table = tables[first];
+				uint64_t fileSize = directory[first].originalSize;
+
+				uint32_t checksum = checksums.front();
+				for (size_t j = 1; j < checksums.size(); j++)
+				{
+					checksum = Checksum::Combine(
+						checksum,
+						checksums[j],
+						min(table.blockSize, fileSize - j * table.blockSize));
+				}
+
+				if (checksum != directory[first].checksum)
+				{
+					ForceClose(
+						"Checksum mismatch for file '" + directory[first].relPath + "' in archive '" + origin + "' (corruption suspected)!\n",
+						ForceCloseType::TYPE_DECOMPRESSION);
+
+					return false;
+				}
+			}
+
+			for (size_t j = first; j < last; j++)
+			{
+				const DirectoryEntry& entry = directory[j];
+
+				if (entry.originalSize == 0) emptyCount++;
+				else if (entry.method == 5
+					|| entry.storedSize < entry.originalSize)
+				{
+					compCount++;
+				}
+				else rawCount++;
+
+				LogExtractedEntry(entry);
+			}
+
+			return true;
+		};
+
+	//one thread decodes every unit itself through the same reader
+	if (threadCount == 1)
+	{
+		for (const ExtractUnit& unit : units)
+		{
+			string error{};
+			if (!ExtractEntries(
+				readers.front(),
+				directory,
+				unit.first,
+				unit.last,
+				outPaths,
+				dictionary,
+				origin,
+				target,
+				error))
+			{
+				ForceClose(
+					error,
+					ForceCloseType::TYPE_DECOMPRESSION);
+
+				return false;
+			}
+
+			if (!FinishUnit(unit)) return false;
+		}
+
+		return true;
+	}
+
+	//set before leaving early, units still queued then return without reading anything
+	atomic<bool> stopped{};
+
+	//declared after everything its tasks use, so the queued tasks it runs
+	//before it is destroyed never outlive the readers, paths or tables
+	ThreadPool pool(threadCount);
+
+	//results are taken in archive order so the log matches the single-threaded path,
+	//at most two units per thread are queued so a failure stops the rest quickly
+	size_t maxInFlight = pool.GetThreadCount() * 2;
+
+	//every task returns why its unit failed, or nothing, the workers never close the program
+	vector<future<string>> extracted(units.size());
+	size_t submitted = 0;
+
+	auto SubmitNext = [&]()
+		{
+			ExtractUnit unit = units[submitted];
+			size_t first = unit.first;
+			size_t last = unit.last;
+
+			auto task = make_shared<packaged_task<string()>>(
+				[&, unit, first, last]()
+				{
+					string error{};
+					if (stopped) return error;
+
+					if (unit.block != SIZE_MAX)
+					{
+						ExtractFileBlock(
+							readers[pool.GetWorkerIndex()],
+							directory[first],
+							tables[first],
+							unit.block,
+							outPaths[first],
+							dictionary,
+							origin,
+							target,
+							blockChecksums[first][unit.block],
+							error);
+					}
+					else
+					{
+						ExtractEntries(
+							readers[pool.GetWorkerIndex()],
+							directory,
+							first,
+							last,
+							outPaths,
+							dictionary,
+							origin,
+							target,
+							error);
+					}
+
+					return error;
+				});
+
+			extracted[submitted++] = task->get_future();
+			pool.Submit([task]() { (*task)(); });
+		};
+
+	for (size_t i = 0; i < units.size(); i++)
+	{
+		while (submitted < units.size()
+			&& submitted < i + maxInFlight)
+		{
+			SubmitNext();
+		}
+
+		string error = extracted[i].get();
+		if (!error.empty())
+		{
+			stopped = true;
+
+			ForceClose(
+				error,
+				ForceCloseType::TYPE_DECOMPRESSION);
+
+			return false;
+		}
+
+		if (!FinishUnit(units[i]))
+		{
+			stopped = true;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ExtractFileBlock(
+	ifstream& in,
+	const DirectoryEntry& entry,
+	const FileBlockTable& table,
+	size_t block,
+	const path& outPath,
+	const vector<uint8_t>& dictionary,
+	const string& origin,
+	const string& target,
+	uint32_t& outChecksum,
+	string& outError)
+{
+	vector<uint8_t> data{};
+	if (!DecodeFileBlock(
+		in,
+		table,
+		block,
+		entry.originalSize,
+		dictionary,
+		entry.relPath,
+		origin,
+		data,
+		outError))
+	{
+		return false;
+	}
+
+	outChecksum = Checksum::Crc32(data.data(), data.size());
+
+	//every worker opens the file on its own and only writes its own block
+	fstream outFile(outPath, ios::in | ios::out | ios::binary);
+	outFile.seekp(static_cast<streamoff>(block * table.blockSize));
+	outFile.write((char*)data.data(), data.size());
+	if (!outFile.good())
+	{
+		outError = "Failed to extract block '" + to_string(block) + "' of file '" + entry.relPath + "' from archive '" + origin + "' into target folder '" + target + "'!\n";
+		return false;
+	}
+
+	return true;
+}
+
+void LogExtractedEntry(const DirectoryEntry& entry)
+{
+	if (!Core::IsVerboseLoggingEnabled()) return;
+
+	string fileName = path(entry.relPath).filename().string();
+
+	ostringstream ss{};
+
+	switch (entry.method)
+	{
+	case 0:
+		if (entry.storedSize == 0) ss << "[EMPTY] '" << fileName << "'";
+		else
+		{
+			ss << "[RAW] '" << fileName
+				<< "' - '" << entry.storedSize << " bytes' "
+				<< ">= '" << entry.originalSize << " bytes'";
+		}
+		break;
+	case 5:
+		ss << "[SOLID] '" << fileName
+			<< "' - '" << entry.originalSize << " bytes' "
+			<< "at block offset '" << entry.blockOffset << "'";
+		break;
+	case 6:
+		ss << "[DICTIONARY] '" << entry.originalSize << " bytes'";
+		break;
+	case 7:
+		ss << "[BLOCKS] '" << fileName
+			<< "' - '" << entry.storedSize << " bytes' "
+			<< (entry.storedSize < entry.originalSize ? "< '" : ">= '") << entry.originalSize << " bytes'";
+		break;
+	default:
+		ss << "[DECOMPRESS] '" << fileName
+			<< "' - '" << entry.storedSize << " bytes' "
+			<< "< '" << entry.originalSize << " bytes'";
+		break;
+	}
+
+	Core::PrintMessage(ss.str());
+}
+
+string MethodName(uint8_t method)
+{
+	switch (method)
+	{
+	case 0: return "raw";
+	case 3: return "range";
+	case 4: return "streams";
+	case 5: return "solid";
+	case 6: return "dictionary";
+	case 7: return "blocks";
+	}
+
+	return "unknown";
+}
+
+string FormatChecksum(uint32_t checksum)
+{
+	ostringstream ss{};
+	ss << hex << setfill('0') << setw(8) << checksum;
+
+	return ss.str();
+}
+
+vector<uint8_t> CompressBuffer(
+	CompressContext& context,
+	const vector<uint8_t>& input,
+	size_t start,
+	bool startsWithDictionary,
+	const string& origin)
+{
+	vector<uint8_t> output{};
+
+	if (input.size() == start) return output;
+
+	//no match reaches further back than the buffer start, so small buffers
+	//don't pay for the match finder tables of the full window.
+	//Powers of two keep the number of dictionary match finders small
+	size_t windowSize = min(
+		context.windowSize,
+		bit_ceil(max(input.size(), WINDOW_SIZE_FASTEST)));
+
+	//repeats further back than the window come from the long-distance matcher
+	vector<LongMatch> longMatches{};
+	if (context.longMatchMemory > 0)
+	{
+		longMatches = LongMatchFinder::Find(
+			input,
+			windowSize,
+			context.longMatchMemory);
+	}
+
+	//long-distance offsets may reach back to the start of the buffer
+	TokenWriter writer(
+		output,
+		longMatches.empty() ? windowSize : input.size());
+
+	//the history only enters the match finder, tokens start after it.
+	//Any history but the dictionary is only added for this buffer
+	unique_ptr<MatchFinder> matchFinder{};
+	if (start > 0
+		&& startsWithDictionary)
+	{
+		matchFinder = CreatePrimedFinder(context, input, start, windowSize);
+	}
+	else
+	{
+		matchFinder = MatchFinder::Create(
+			context.matchFinder,
+			input,
+			windowSize,
+			context.lookAhead,
+			context.maxChain);
+
+		for (size_t i = 0; i < start; i++)
+		{
+			matchFinder->Skip(i);
+		}
+	}
+
+	if (context.parser == ParserType::PARSER_OPTIMAL)
+	{
+		ParseOptimal(
+			context,
+			input,
+			start,
+			*matchFinder,
+			longMatches,
+			writer);
+	}
+	else if (!ParseLazy(
+		context,
+		input,
+		start,
+		*matchFinder,
+		longMatches,
+		writer,
+		origin))
+	{
+		return {};
+	}
+
+	if (output.empty())
+	{
+		ForceClose(
+			"Compression produced empty output for file '" + origin + "' (unexpected)!\n",
+			ForceCloseType::TYPE_COMPRESSION_BUFFER);
+	}
+
+	return output;
 }
 
-vector<uint8_t> CompressBuffer(
+unique_ptr<MatchFinder> CreatePrimedFinder(
+	CompressContext& context,
+	const vector<uint8_t>& input,
+	size_t start,
+	size_t windowSize)
+{
+	//cached finders are never changed, only cloned, so the lock
+	//is only held to look one up or to build a missing one
+	lock_guard<mutex> guard(context.primedLock);
+
+	for (const auto& primed : context.primedFinders)
+	{
+		if (primed.windowSize == windowSize) return primed.finder->Clone(input);
+	}
+
+	//the finder is built over the dictionary alone so it never
+	//compares bytes of the buffer it was first needed for
+	unique_ptr<MatchFinder> finder = MatchFinder::Create(
+		context.matchFinder,
+		context.dictionary,
+		windowSize,
+		context.lookAhead,
+		context.maxChain);
+
+	for (size_t i = 0; i < start; i++)
+	{
+		finder->Skip(i);
+	}
+
+	context.primedFinders.push_back({ windowSize, move(finder) });
+
+	return context.primedFinders.back().finder->Clone(input);
+}
+
+bool ParseLazy(
+	const CompressContext& context,
 	const vector<uint8_t>& input,
+	size_t start,
+	MatchFinder& matchFinder,
+	const vector<LongMatch>& longMatches,
+	TokenWriter& writer,
 	const string& origin)
 {
-	size_t windowSize = Compress::GetWindowSize();
-	size_t lookAhead = Compress::GetLookAhead();
+	size_t lookAhead = context.lookAhead;
+	size_t lazyDepth = context.lazyDepth;
 
-	vector<uint8_t> output{};
+	//matches found ahead of pos by the lazy check, indexed by position % 4
+	Match found[4]{};
+	size_t searched = start;
+
+	auto FindAt = [&](size_t at) -> const Match&
+		{
+			while (searched <= at)
+			{
+				Match& slot = found[searched % 4];
+				slot.length = matchFinder.FindMatch(searched, slot.offset);
+				searched++;
+			}
 
-	if (input.empty()) return output;
+			return found[at % 4];
+		};
 
-	size_t pos = 0;
+	RepHistory reps{};
+	size_t nextLong = 0;
+	size_t pos = start;
 
 	while (pos < input.size())
 	{
-		size_t bestLength = 0;
-		size_t bestOffset = 0;
-		size_t start = (pos > windowSize) ? (pos - windowSize) : 0;
-
-		//search backwards in window
-		for (size_t i = start; i < pos; i++)
+		//repeat offsets are checked before the search, they cost no offset bits
+		size_t repOffset = 0;
+		size_t repLength = FindRepMatch(
+			input,
+			pos,
+			reps,
+			min(lookAhead, input.size() - pos),
+			repOffset);
+
+		size_t bestOffset = repOffset;
+		size_t bestLength = repLength;
+
+		//a repeat that reaches the lookahead is taken without searching at all,
+		//otherwise it wins unless the search finds a match 2 bytes longer
+		if (repLength < lookAhead)
 		{
-			size_t length = 0;
-
-			while (length < lookAhead
-				&& pos + length < input.size()
-				&& input[i + length] == input[pos + length])
+			const Match& best = FindAt(pos);
+			if (best.length > repLength + 1)
 			{
-				length++;
+				bestOffset = best.offset;
+				bestLength = best.length;
 			}
+		}
 
-			if (length > bestLength
-				&& length >= MIN_MATCH)
+		//lazy evaluation: if a strictly longer match starts within the next
+		//lazyDepth bytes, emit a literal now and take that match instead.
+		//each extra step costs one more literal, so it must win by that much
+		if (bestLength >= MIN_MATCH
+			&& bestLength < lookAhead)
+		{
+			for (size_t step = 1;
+				step <= lazyDepth
+				&& pos + step < input.size();
+				step++)
 			{
-				bestLength = length;
-				bestOffset = pos - i;
+				if (FindAt(pos + step).length > bestLength + step - 1)
+				{
+					bestLength = 0;
+					break;
+				}
 			}
 		}
 
+		if (bestLength >= lookAhead)
+		{
+			bestLength = ExtendMatch(
+				input,
+				pos,
+				bestOffset,
+				bestLength,
+				min(MAX_MATCH, input.size() - pos));
+		}
+
+		//long-distance matches reach past the window, they win whenever they are longer
+		size_t longOffset = 0;
+		size_t longLength = FindLongMatch(
+			longMatches,
+			nextLong,
+			pos,
+			min(MAX_MATCH, input.size() - pos),
+			longOffset);
+
+		if (longLength > bestLength)
+		{
+			bestOffset = longOffset;
+			bestLength = longLength;
+		}
+
 		if (bestLength >= MIN_MATCH)
 		{
 			if (bestOffset >= UINT32_MAX)
@@ -794,517 +3496,401 @@ vector<uint8_t> CompressBuffer(
 					"Offset too large for file '" + origin + "' during compressing (data window exceeded)!\n",
 					ForceCloseType::TYPE_COMPRESSION_BUFFER);
 
-				return {};
+				return false;
 			}
 
-			uint8_t flag = 0;
-			output.push_back(flag);
-
-			uint32_t offset = (uint32_t)bestOffset;
-			output.insert(output.end(),
-				reinterpret_cast<uint8_t*>(&offset),
-				reinterpret_cast<uint8_t*>(&offset) + sizeof(uint32_t));
-
-			if (bestLength > UINT8_MAX)
+			if (bestLength > MAX_MATCH)
 			{
 				ForceClose(
 					"Match length too large for file '" + origin + "' during compressing (overflow)!\n",
 					ForceCloseType::TYPE_COMPRESSION_BUFFER);
 
-				return {};
+				return false;
 			}
 
-			uint8_t len8 = (uint8_t)bestLength;
-			output.push_back(len8);
+			writer.Match(
+				static_cast<uint32_t>(bestOffset),
+				bestLength);
+			reps.Update(static_cast<uint32_t>(bestOffset));
 
+			//every covered position must be in the finder for later matches,
+			//the lazy check may already have searched the first few
 			pos += bestLength;
+			for (; searched < pos; searched++)
+			{
+				matchFinder.Skip(searched);
+			}
 		}
 		else
 		{
-			uint8_t flag = 1;
-			output.push_back(flag);
-			output.push_back(input[pos]);
+			writer.Literal(input[pos]);
 			pos++;
 		}
 	}
 
-	if (output.empty())
-	{
-		ForceClose(
-			"Compression produced empty output for file '" + origin + "' (unexpected)!\n",
-			ForceCloseType::TYPE_COMPRESSION_BUFFER);
-	}
-
-	return output;
+	return true;
 }
 
-void DecompressBuffer(
-	const vector<uint8_t>& lzssStream,
-	vector<uint8_t>& out,
-	size_t originalSize,
-	const string& target)
+void ParseOptimal(
+	const CompressContext& context,
+	const vector<uint8_t>& input,
+	size_t start,
+	MatchFinder& matchFinder,
+	const vector<LongMatch>& longMatches,
+	TokenWriter& writer)
 {
-	//skip decompressing empty file
-	if (originalSize == 0)
-	{
-		out.clear();
-		return;
-	}
+	size_t lookAhead = context.lookAhead;
+	size_t niceLength = min(lookAhead, OPTIMAL_NICE_LENGTH);
 
-	vector<uint8_t> buffer{};
-	buffer.reserve(originalSize);
+	//token statistics of every block written so far
+	TokenStats totalStats{};
 
-	size_t pos = 0;
+	//candidate matches of the current block, candidateStart[i] indexes position i
+	vector<Match> candidates{};
+	vector<size_t> candidateStart{};
+	vector<Match> found{};
 
-	while (pos < lzssStream.size())
-	{
-		uint8_t flag = lzssStream[pos++];
+	//positions inside a very long match, they are neither searched nor checked for repeats
+	vector<uint8_t> covered{};
 
-		if (flag == 1) //literal
-		{
-			if (pos >= lzssStream.size())
-			{
-				ForceClose(
-					"Unexpected end of LZSS stream while reading literal in '" + target + "'!\n",
-					ForceCloseType::TYPE_DECOMPRESSION_BUFFER);
+	//cheapest cost in bits to reach each position, the token that gets there
+	//and the repeat offsets after the cheapest path to it
+	vector<uint32_t> cost{};
+	vector<Token> from{};
+	vector<RepHistory> reps{};
+	vector<Token> path{};
 
-				return;
-			}
+	//repeat offsets at the start of the current block
+	RepHistory blockReps{};
 
-			uint8_t c = lzssStream[pos++];
-			buffer.push_back(c);
-		}
-		else //reference
-		{
-			if (pos + sizeof(uint16_t) + sizeof(uint8_t) > lzssStream.size())
-			{
-				ForceClose(
-					"Unexpected end of LZSS stream while reading reference in '" + target + "'!\n",
-					ForceCloseType::TYPE_DECOMPRESSION_BUFFER);
+	size_t nextLong = 0;
 
-				return;
-			}
+	for (size_t blockStart = start; blockStart < input.size(); blockStart += OPTIMAL_BLOCK_SIZE)
+	{
+		size_t blockLength = min(OPTIMAL_BLOCK_SIZE, input.size() - blockStart);
 
-			uint32_t offset = *reinterpret_cast<const uint32_t*>(&lzssStream[pos]);
-			pos += sizeof(uint32_t);
+		//gather every candidate once, the passes below only re-price them
+		candidates.clear();
+		candidateStart.assign(blockLength + 1, 0);
+		covered.assign(blockLength + 1, 0);
 
-			uint8_t length = lzssStream[pos++];
+		for (size_t i = 0; i < blockLength;)
+		{
+			candidateStart[i] = candidates.size();
 
-			if (offset == 0)
+			size_t longest = matchFinder.FindMatches(blockStart + i, found);
+			for (const auto& match : found)
 			{
-				ostringstream ss{};
-
-				ss << "Offset size is '0' in LZSS stream for archive '" << target << "' (corruption suspected)!\n";
-
-				ForceClose(
-					ss.str(),
-					ForceCloseType::TYPE_DECOMPRESSION_BUFFER);
-
-				return;
+				//matches may not cross the block end
+				size_t length = min(match.length, blockLength - i);
+				if (length >= MIN_MATCH) candidates.push_back({ length, match.offset });
 			}
-			if (offset > buffer.size())
-			{
-				ostringstream ss{};
 
-				ss << "Offset size '" << offset << "' is bigger than buffer size '"
-					<< buffer.size() << "' in LZSS stream for archive '" << target << "' (corruption suspected)!\n";
+			//a long-distance match joins the candidates when it beats the window matches
+			size_t longOffset = 0;
+			size_t longLength = FindLongMatch(
+				longMatches,
+				nextLong,
+				blockStart + i,
+				min(MAX_MATCH, blockLength - i),
+				longOffset);
 
-				ForceClose(
-					ss.str(),
-					ForceCloseType::TYPE_DECOMPRESSION_BUFFER);
-
-				return;
+			if (longLength > min(longest, blockLength - i))
+			{
+				candidates.push_back({ longLength, longOffset });
+				longest = longLength;
 			}
+			i++;
 
-			size_t start = buffer.size() - offset;
-			for (size_t i = 0; i < length; i++)
+			//a very long match is taken as is, the positions it covers only get literal transitions
+			if (longest >= niceLength)
 			{
-				if (buffer.size() >= originalSize)
+				if (longest >= lookAhead
+					&& candidates.size() > candidateStart[i - 1])
 				{
-					ostringstream ss{};
-
-					ss << "Decompressed size '" << buffer.size() << "' "
-						<< "exceeds expected size '" << originalSize << "' "
-						<< "while reading archive '" << target << "'!\n";
-
-					ForceClose(
-						ss.str(),
-						ForceCloseType::TYPE_DECOMPRESSION_BUFFER);
+					Match& last = candidates.back();
+					last.length = ExtendMatch(
+						input,
+						blockStart + i - 1,
+						last.offset,
+						last.length,
+						min(MAX_MATCH, blockLength - (i - 1)));
+					longest = last.length;
+				}
 
-					return;
+				size_t end = min(i - 1 + longest, blockLength);
+				for (; i < end; i++)
+				{
+					candidateStart[i] = candidates.size();
+					covered[i] = 1;
+					matchFinder.Skip(blockStart + i);
 				}
-				buffer.push_back(buffer[start + i]);
 			}
 		}
-	}
-
-	if (buffer.size() != originalSize) 
-	{
-		ostringstream ss{};
-
-		ss << "Decompressed size '" << buffer.size()
-			<< "' does not match expected size '" << originalSize
-			<< "' for archive '" << target << "' (possible corruption)!\n";
-
-		ForceClose(
-			ss.str(),
-			ForceCloseType::TYPE_DECOMPRESSION_BUFFER);
-
-		return;
-	}
-
-	//hand decompressed data back to caller
-	out = move(buffer);
-}
-
-void BuildCodes(
-	HuffNode* node,
-	const string& prefix,
-	map<uint8_t, string>& codes)
-{
-	if (!node->left
-		&& !node->right)
-	{
-		codes[node->symbol] = prefix.empty() ? "0" : prefix;
-	}
-
-	if (node->left) BuildCodes(node->left.get(), prefix + "0", codes);
-	if (node->right) BuildCodes(node->right.get(), prefix + "1", codes);
-}
+		candidateStart[blockLength] = candidates.size();
 
-vector<uint8_t> HuffmanEncode(
-	const vector<uint8_t>& input,
-	const string& origin)
-{
-	if (input.empty()) return {};
-
-	size_t freq[256]{};
-	for (auto b : input) freq[b]++;
+		TokenStats passStats{};
+		TokenPrices prices{};
 
-	//build priority queue
-	priority_queue<unique_ptr<HuffNode>, vector<unique_ptr<HuffNode>>, NodeCompare> pq{};
-	for (int i = 0; i < 256; i++)
-	{
-		if (freq[i] > 0) pq.push(make_unique<HuffNode>((uint8_t)i, freq[i]));
-	}
-	if (pq.empty())
-	{
-		ForceClose(
-			"HuffmanEncode found no symbols in '" + origin + "'",
-			ForceCloseType::TYPE_HUFFMAN_ENCODE);
+		for (size_t pass = 0; pass < OPTIMAL_PASSES; pass++)
+		{
+			//price every stream symbol by its Huffman code length,
+			//later passes add the statistics of the previous pass of this block
+			TokenStats stats{};
+			for (int b = 0; b < 256; b++)
+			{
+				stats.flags[b] = totalStats.flags[b] + passStats.flags[b];
+				stats.literals[b] = totalStats.literals[b] + passStats.literals[b];
+				stats.lengths[b] = totalStats.lengths[b] + passStats.lengths[b];
+				stats.slots[b] = totalStats.slots[b] + passStats.slots[b];
+			}
 
-		return {};
-	}
-	if (pq.size() == 1) pq.push(make_unique<HuffNode>(0, 1));
+			BuildPrices(stats.flags, prices.flags, 1);
+			BuildPrices(stats.literals, prices.literals, 8);
+			BuildPrices(stats.lengths, prices.lengths, 8);
+			BuildPrices(stats.slots, prices.slots, 6);
 
-	while (pq.size() > 1)
-	{
-		auto ExtractTop = [&](auto& q)
+			auto LengthPrice = [&prices](size_t length) -> uint32_t
+				{
+					size_t lengthValue = length - MIN_MATCH;
+					return lengthValue < LENGTH_ESCAPE
+						? prices.lengths[lengthValue]
+						: prices.lengths[LENGTH_ESCAPE] + LENGTH_ESCAPE_BITS;
+				};
+
+			cost.assign(blockLength + 1, UINT32_MAX);
+			from.assign(blockLength + 1, Token{});
+			reps.resize(blockLength + 1);
+			cost[0] = 0;
+			reps[0] = blockReps;
+
+			for (size_t i = 0; i < blockLength; i++)
 			{
-				unique_ptr<HuffNode> node = move(const_cast<unique_ptr<HuffNode>&>(q.top()));
-				q.pop();
-				return node;
-			};
+				uint32_t here = cost[i];
 
-		auto left = ExtractTop(pq);
-		auto right = ExtractTop(pq);
+				//every way into i is priced by now, so its repeat offsets are final
+				if (i > 0)
+				{
+					const Token& token = from[i];
+					reps[i] = reps[i - token.length];
+					if (!token.isLiteral) reps[i].Update(token.offset);
+				}
 
-		auto merged = make_unique<HuffNode>(move(left), move(right));
-		pq.push(move(merged));
-	}
-	unique_ptr<HuffNode> root = move(const_cast<unique_ptr<HuffNode>&>(pq.top()));
+				uint32_t literalCost = here + prices.flags[1] + prices.literals[input[blockStart + i]];
+				if (literalCost < cost[i + 1])
+				{
+					cost[i + 1] = literalCost;
+					from[i + 1] = { true, input[blockStart + i], 0, 1 };
+				}
 
-	//build codes
-	map<uint8_t, string> codes{};
-	BuildCodes(root.get(), "", codes);
+				//each candidate covers the lengths above the previous, shorter candidate
+				size_t previousLength = MIN_MATCH - 1;
+				for (size_t c = candidateStart[i]; c < candidateStart[i + 1]; c++)
+				{
+					const Match& match = candidates[c];
+					uint32_t offset = static_cast<uint32_t>(match.offset);
+					uint32_t slot = OffsetSlot(offset - 1);
 
-	//serialize frequency table
-	uint16_t nonZero = 0;
-	for (int i = 0; i < 256; i++)
-	{
-		if (freq[i] > 0) nonZero++;
-	}
+					uint32_t matchCost = here
+						+ prices.flags[0]
+						+ prices.slots[slot]
+						+ OffsetExtraBits(slot);
 
-	size_t denseSize = 256 * sizeof(uint32_t);                //always 1024
+					for (size_t length = previousLength + 1; length <= match.length; length++)
+					{
+						uint32_t total = matchCost + LengthPrice(length);
+						if (total < cost[i + length])
+						{
+							cost[i + length] = total;
+							from[i + length] = { false, 0, offset, static_cast<uint32_t>(length) };
+						}
+					}
 
-	constexpr size_t entrySize = 5;
-	if (nonZero > (SIZE_MAX - sizeof(uint16_t)) / entrySize)
-	{
-		ForceClose(
-			"Sparse size overflow in '" + origin + "'!\n",
-			ForceCloseType::TYPE_HUFFMAN_ENCODE);
+					previousLength = max(previousLength, match.length);
+				}
 
-		return {};
-	}
-	size_t sparseSize = sizeof(uint16_t) + nonZero * entrySize; //count + (sym + freq)
+				//repeat offsets only pay for their rep slot
+				for (uint32_t r = 0; r < REP_COUNT && !covered[i]; r++)
+				{
+					uint32_t offset = reps[i].offsets[r];
+					if (offset == 0
+						|| offset > blockStart + i)
+					{
+						continue;
+					}
 
+					size_t repLength = ExtendMatch(
+						input,
+						blockStart + i,
+						offset,
+						0,
+						min(lookAhead, blockLength - i));
 
-	bool useSparse = (sparseSize < denseSize);
+					uint32_t repCost = here
+						+ prices.flags[0]
+						+ prices.slots[OFFSET_SLOT_COUNT + r];
 
-	vector<uint8_t> output{};
-	uint8_t mode = useSparse ? 1 : 0;
-	output.push_back(mode);
+					//a long repeat is only priced at its full length
+					size_t shortest = repLength >= niceLength
+						? repLength
+						: MIN_MATCH;
 
-	if (useSparse)
-	{
-		//write non-zero count
-		output.insert(
-			output.end(),
-			reinterpret_cast<uint8_t*>(&nonZero),
-			reinterpret_cast<uint8_t*>(&nonZero) + sizeof(uint16_t));
+					for (size_t length = shortest; length <= repLength; length++)
+					{
+						uint32_t total = repCost + LengthPrice(length);
+						if (total < cost[i + length])
+						{
+							cost[i + length] = total;
+							from[i + length] = { false, 0, offset, static_cast<uint32_t>(length) };
+						}
+					}
+				}
+			}
 
-		//write each symbol + frequency
-		for (int i = 0; i < 256; i++)
-		{
-			if (freq[i] > 0)
+			//walk back from the block end to recover the cheapest token path
+			path.clear();
+			for (size_t i = blockLength; i > 0; i -= from[i].length)
 			{
-				uint8_t symbol = (uint8_t)i;
-				uint32_t f = (uint32_t)freq[i];
-				output.push_back(symbol);
-				output.insert(
-					output.end(),
-					reinterpret_cast<uint8_t*>(&f),
-					reinterpret_cast<uint8_t*>(&f) + sizeof(uint32_t));
+				path.push_back(from[i]);
 			}
-		}
-	}
-	else
-	{
-		//write dense table
-		for (int i = 0; i < 256; i++)
-		{
-			uint32_t f = (uint32_t)freq[i];
-			output.insert(
-				output.end(),
-				reinterpret_cast<uint8_t*>(&f),
-				reinterpret_cast<uint8_t*>(&f) + sizeof(uint32_t));
-		}
-	}
-
-	//bit-pack data
-	uint8_t bitbuf = 0;
-	int bitcount = 0;
-	vector<uint8_t> dataBits{};
 
-	for (auto b : input)
-	{
-		const auto it = codes.find(b);
-		if (it == codes.end())
-		{
-			ForceClose(
-				"HuffmanEncode missing code for symbol in '" + origin + "'!\n",
-				ForceCloseType::TYPE_HUFFMAN_ENCODE);
+			passStats = {};
+			RepHistory pathReps = blockReps;
+			for (auto it = path.rbegin(); it != path.rend(); ++it)
+			{
+				if (it->isLiteral)
+				{
+					passStats.flags[1]++;
+					passStats.literals[it->literal]++;
+				}
+				else
+				{
+					uint32_t repIndex = pathReps.Update(it->offset);
 
-			return {};
+					passStats.flags[0]++;
+					passStats.lengths[min<size_t>(it->length - MIN_MATCH, LENGTH_ESCAPE)]++;
+					passStats.slots[repIndex < REP_COUNT
+						? OFFSET_SLOT_COUNT + repIndex
+						: OffsetSlot(it->offset - 1)]++;
+				}
+			}
 		}
 
-		for (char c : it->second)
+		for (auto it = path.rbegin(); it != path.rend(); ++it)
 		{
-			bitbuf <<= 1;
-			if (c == '1') bitbuf |= 1;
-			bitcount++;
-			if (bitcount == 8)
+			if (it->isLiteral) writer.Literal(it->literal);
+			else
 			{
-				dataBits.push_back(bitbuf);
-				bitbuf = 0;
-				bitcount = 0;
+				writer.Match(it->offset, it->length);
+				blockReps.Update(it->offset);
 			}
 		}
-	}
-	if (bitcount > 0)
-	{
-		bitbuf <<= (8 - bitcount);
-		dataBits.push_back(bitbuf);
-	}
 
-	output.insert(
-		output.end(),
-		dataBits.begin(),
-		dataBits.end());
-
-	if (output.empty())
-	{
-		ForceClose(
-			"HuffmanEncode produced empty output for '" + origin + "'!\n",
-			ForceCloseType::TYPE_HUFFMAN_ENCODE);
-
-		return {};
+		for (int b = 0; b < 256; b++)
+		{
+			totalStats.flags[b] += passStats.flags[b];
+			totalStats.literals[b] += passStats.literals[b];
+			totalStats.lengths[b] += passStats.lengths[b];
+			totalStats.slots[b] += passStats.slots[b];
+		}
 	}
-
-	return output;
 }
 
-vector<uint8_t> HuffmanDecode(
-	ifstream& in,
-	size_t storedSize,
-	const string& origin)
+size_t FindLongMatch(
+	const vector<LongMatch>& longMatches,
+	size_t& next,
+	size_t pos,
+	size_t limit,
+	size_t& outOffset)
 {
-	vector<uint8_t> out{};
-
-	if (storedSize < 2)
+	while (next < longMatches.size()
+		&& longMatches[next].pos + longMatches[next].length <= pos)
 	{
-		ForceClose(
-			"Stored size is too small in '" + origin + "'!\n",
-			ForceCloseType::TYPE_HUFFMAN_DECODE);
-
-		return {};
+		next++;
 	}
 
-	//read storage mode flag
-	uint8_t mode{};
-	if (!in.read((char*)&mode, sizeof(uint8_t)))
+	if (next == longMatches.size()
+		|| longMatches[next].pos > pos)
 	{
-		ForceClose(
-			"Unexpected EOF while reading Huffman storage mode in '" + origin + "'!\n",
-			ForceCloseType::TYPE_HUFFMAN_DECODE);
-
-		return {};
+		return 0;
 	}
 
-	size_t freq[256]{};
-	uint16_t nonZero = 0;
-
-	if (mode == 1)
-	{
-		//read nonZero count
-		
-		if (!in.read((char*)&nonZero, sizeof(uint16_t)))
-		{
-			ForceClose(
-				"Unexpected EOF while reading Huffman table size in '" + origin + "'!\n",
-				ForceCloseType::TYPE_HUFFMAN_DECODE);
-
-			return {};
-		}
-
-		//read each (symbol, freq)
-		for (uint16_t i = 0; i < nonZero; i++)
-		{
-			uint8_t symbol{};
-			uint32_t f{};
-			if (!in.read((char*)&symbol, sizeof(uint8_t))
-				|| !in.read((char*)&f, sizeof(uint32_t)))
-			{
-				ForceClose(
-					"Unexpected EOF while reading Huffman sparse table entry in '" + origin + "'!\n",
-					ForceCloseType::TYPE_HUFFMAN_DECODE);
-
-				return {};
-			}
-			freq[symbol] = f;
-		}
-	}
-	else
-	{
-		//dense table
-		for (int i = 0; i < 256; i++)
-		{
-			uint32_t f{};
-			if (!in.read((char*)&f, sizeof(uint32_t)))
-			{
-				ForceClose(
-					"Unexpected EOF while reading Huffman dense table entry in '" + origin + "'!\n",
-					ForceCloseType::TYPE_HUFFMAN_DECODE);
+	const LongMatch& match = longMatches[next];
 
-				return {};
-			}
-			freq[i] = f;
-		}
-	}
+	size_t length = min(match.pos + match.length - pos, limit);
+	if (length < MIN_MATCH) return 0;
 
-	//rebuild tree
-	priority_queue<unique_ptr<HuffNode>, vector<unique_ptr<HuffNode>>, NodeCompare> pq{};
-	size_t totalSymbols{};
-	for (int i = 0; i < 256; i++)
-	{
-		if (freq[i] > 0)
-		{
-			pq.push(make_unique<HuffNode>((uint8_t)i, freq[i]));
-			totalSymbols += freq[i];
-		}
-	}
-	if (pq.empty())
-	{
-		ForceClose(
-			"Found empty frequency table in '" + origin + "'!\n",
-			ForceCloseType::TYPE_HUFFMAN_DECODE);
+	outOffset = match.offset;
+	return length;
+}
 
-		return {};
-	}
-	if (pq.size() == 1) pq.push(make_unique<HuffNode>(0, 1));
+void BuildPrices(
+	const size_t freq[256],
+	uint32_t price[256],
+	uint32_t fallback)
+{
+	uint8_t lengths[256]{};
+	Huffman::BuildCodeLengths(freq, lengths);
 
-	while (pq.size() > 1)
+	uint32_t maxPrice = *max_element(lengths, lengths + 256);
+	if (maxPrice == 0)
 	{
-		auto ExtractTop = [&](auto& q)
-			{
-				unique_ptr<HuffNode> node = move(const_cast<unique_ptr<HuffNode>&>(q.top()));
-				q.pop();
-				return node;
-			};
-
-		auto left = ExtractTop(pq);
-		auto right = ExtractTop(pq);
-
-		auto merged = make_unique<HuffNode>(move(left), move(right));
-		pq.push(move(merged));
+		fill(price, price + 256, fallback);
+		return;
 	}
-	unique_ptr<HuffNode> root = move(const_cast<unique_ptr<HuffNode>&>(pq.top()));
-	pq.pop();
 
-	//read remaining bitstream
-	size_t headerBytes = 0;
-	if (mode == 1)
-	{
-		//sparse
-		headerBytes = sizeof(uint8_t) + sizeof(uint16_t) + nonZero * (sizeof(uint8_t) + sizeof(uint32_t));
-	}
-	else
+	for (int b = 0; b < 256; b++)
 	{
-		//dense
-		headerBytes = sizeof(uint8_t) + 256 * sizeof(uint32_t);
+		price[b] = lengths[b] > 0 ? lengths[b] : maxPrice + 1;
 	}
+}
 
-	size_t remaining = storedSize - headerBytes;
-
-	vector<uint8_t> bitstream(remaining);
-	if (!in.read((char*)bitstream.data(), remaining))
-	{
-		ForceClose(
-			"Unexpected EOF while reading Huffman bitstream in '" + origin + "'!\n",
-			ForceCloseType::TYPE_HUFFMAN_DECODE);
-
-		return {};
-	}
+size_t FindRepMatch(
+	const vector<uint8_t>& input,
+	size_t pos,
+	const RepHistory& reps,
+	size_t limit,
+	size_t& outOffset)
+{
+	size_t bestLength = 0;
 
-	//decode
-	HuffNode* node = root.get();
-	for (size_t i = 0; i < bitstream.size(); i++)
+	for (uint32_t r = 0; r < REP_COUNT; r++)
 	{
-		uint8_t byte = bitstream[i];
-		for (int b = 7; b >= 0; b--)
+		size_t offset = reps.offsets[r];
+		if (offset == 0
+			|| offset > pos)
 		{
-			int bit = (byte >> b) & 1;
-			node = (bit == 0) ? node->left.get() : node->right.get();
+			continue;
+		}
 
-			if (!node->left
-				&& !node->right)
-			{
-				out.push_back(node->symbol);
-				node = root.get();
+		size_t length = ExtendMatch(
+			input,
+			pos,
+			offset,
+			0,
+			limit);
 
-				if (out.size() == totalSymbols) return out;
-			}
+		if (length > bestLength)
+		{
+			bestLength = length;
+			outOffset = offset;
 		}
 	}
 
-	if (out.size() != totalSymbols)
-	{
-		ForceClose(
-			"Output size mismatch in '" + origin + "'!\n",
-			ForceCloseType::TYPE_HUFFMAN_DECODE);
+	return bestLength >= MIN_MATCH ? bestLength : 0;
+}
 
-		return {};
-	}
+size_t ExtendMatch(
+	const vector<uint8_t>& input,
+	size_t pos,
+	size_t offset,
+	size_t length,
+	size_t limit)
+{
+	const uint8_t* data = input.data();
 
-	return out;
+	return length + MatchFinder::MatchLength(
+		data + pos + length - offset,
+		data + pos + length,
+		limit - length);
 }
\ No newline at end of file
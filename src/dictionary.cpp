@@ -0,0 +1,363 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+
+#include "core.hpp"
+#include "command.hpp"
+#include "dictionary.hpp"
+
+using KalaData::Core;
+using KalaData::MessageType;
+using KalaData::Command;
+using KalaData::Dictionary;
+using KalaData::DICTIONARY_SIZE;
+using KalaData::DICTIONARY_MAX_SIZE;
+using KalaData::DICTIONARY_MAX_SAMPLES;
+
+using std::vector;
+using std::string;
+using std::filesystem::path;
+using std::filesystem::is_regular_file;
+using std::filesystem::file_size;
+using std::filesystem::recursive_directory_iterator;
+using std::ofstream;
+using std::ifstream;
+using std::ios;
+using std::streamsize;
+using std::ostringstream;
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+using std::fixed;
+using std::setprecision;
+using std::min;
+using std::max;
+using std::sort;
+using std::stable_sort;
+using std::memcpy;
+using std::memcmp;
+
+//substrings are counted and compared in units of this many bytes
+constexpr size_t DMER_SIZE = 8;
+constexpr uint32_t DMER_HASH_BITS = 22;
+
+//the dictionary is built from segments of this many sample bytes
+constexpr size_t SEGMENT_SIZE = 512;
+
+//A picked sample segment and how many samples share its substrings
+struct Segment
+{
+	size_t start;
+	uint64_t score;
+};
+
+//Hash of the DMER_SIZE bytes at p
+static uint32_t HashDmer(const uint8_t* p);
+
+//Best segment of SEGMENT_SIZE bytes that starts in [epochStart, epochEnd - SEGMENT_SIZE],
+//each distinct substring in it scores its sample count once
+static Segment FindBestSegment(
+	const vector<uint8_t>& samples,
+	size_t epochStart,
+	size_t epochEnd,
+	const vector<uint32_t>& freq,
+	vector<uint16_t>& inWindow);
+
+namespace KalaData
+{
+	void Dictionary::TrainToFile(
+		const string& origin,
+		const string& target)
+	{
+		Command::SetCommandAllowState(false);
+
+		Core::PrintMessage(
+			"Starting to train dictionary '" + target + "' from folder '" + origin + "'!\n");
+
+		//start clock timer
+		auto start = high_resolution_clock::now();
+
+		//collect all files, sorted so the same folder always trains the same dictionary
+		vector<path> files{};
+		for (auto& p : recursive_directory_iterator(origin))
+		{
+			if (is_regular_file(p)) files.push_back(p.path());
+		}
+		sort(files.begin(), files.end());
+
+		vector<uint8_t> samples{};
+		vector<size_t> sampleSizes{};
+
+		for (const auto& file : files)
+		{
+			if (samples.size() >= DICTIONARY_MAX_SAMPLES) break;
+
+			size_t sampleSize = static_cast<size_t>(min<uintmax_t>(
+				file_size(file),
+				DICTIONARY_MAX_SAMPLES - samples.size()));
+
+			if (sampleSize == 0) continue;
+
+			size_t sampleStart = samples.size();
+			samples.resize(sampleStart + sampleSize);
+
+			ifstream in(file, ios::binary);
+			in.read((char*)samples.data() + sampleStart, static_cast<streamsize>(sampleSize));
+
+			//files that shrank since they were listed only contribute what was read
+			sampleSize = static_cast<size_t>(in.gcount());
+			samples.resize(sampleStart + sampleSize);
+
+			if (sampleSize > 0) sampleSizes.push_back(sampleSize);
+		}
+
+		vector<uint8_t> dictionary = Train(
+			samples,
+			sampleSizes,
+			DICTIONARY_SIZE);
+
+		if (dictionary.empty())
+		{
+			Core::PrintMessage(
+				"Files in folder '" + origin + "' have no content in common to train a dictionary from!\n",
+				MessageType::MESSAGETYPE_ERROR);
+
+			Command::SetCommandAllowState(true);
+
+			return;
+		}
+
+		ofstream out(target, ios::binary);
+		if (!out.is_open())
+		{
+			Core::ForceClose(
+				"Dictionary error",
+				"Failed to open target dictionary '" + target + "'!\n");
+
+			return;
+		}
+
+		const char magicVer[6] = { 'K', 'D', 'I', 'C', KALADATA_VERSION[9], KALADATA_VERSION[11] };
+		uint32_t dictionarySize = static_cast<uint32_t>(dictionary.size());
+
+		out.write(magicVer, sizeof(magicVer));
+		out.write((char*)&dictionarySize, sizeof(uint32_t));
+		out.write((char*)dictionary.data(), dictionary.size());
+
+		if (!out.good())
+		{
+			Core::ForceClose(
+				"Dictionary error",
+				"Failed to write dictionary data to '" + target + "'!\n");
+
+			return;
+		}
+
+		out.close();
+
+		//end timer
+		auto end = high_resolution_clock::now();
+		auto durationSec = duration<double>(end - start).count();
+
+		ostringstream finishTrain{};
+
+		finishTrain
+			<< "Finished training dictionary '" << path(target).filename().string()
+			<< "' from folder '" << path(origin).filename().string() << "'!\n"
+			<< "  - sample files: " << sampleSizes.size() << "\n"
+			<< "  - sample size: " << samples.size() << " bytes\n"
+			<< "  - dictionary size: " << dictionary.size() << " bytes\n"
+			<< "  - duration: " << fixed << setprecision(2) << durationSec << " seconds\n";
+
+		Core::PrintMessage(
+			finishTrain.str(),
+			MessageType::MESSAGETYPE_SUCCESS);
+
+		Command::SetCommandAllowState(true);
+	}
+
+	bool Dictionary::Load(
+		const string& origin,
+		vector<uint8_t>& out)
+	{
+		ifstream in(origin, ios::binary);
+		if (!in.is_open()) return false;
+
+		char magicVer[6]{};
+		in.read(magicVer, sizeof(magicVer));
+
+		const char expected[6] = { 'K', 'D', 'I', 'C', KALADATA_VERSION[9], KALADATA_VERSION[11] };
+		if (memcmp(magicVer, expected, sizeof(expected)) != 0) return false;
+
+		uint32_t size{};
+		in.read((char*)&size, sizeof(uint32_t));
+
+		if (!in.good()
+			|| size == 0
+			|| size > DICTIONARY_MAX_SIZE)
+		{
+			return false;
+		}
+
+		out.resize(size);
+		if (!in.read((char*)out.data(), static_cast<streamsize>(size)))
+		{
+			out.clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	vector<uint8_t> Dictionary::Train(
+		const vector<uint8_t>& samples,
+		const vector<size_t>& sampleSizes,
+		size_t dictionarySize)
+	{
+		if (samples.size() < SEGMENT_SIZE
+			|| dictionarySize < SEGMENT_SIZE)
+		{
+			return {};
+		}
+
+		//how many samples contain each substring, counted once per sample
+		vector<uint32_t> freq(static_cast<size_t>(1) << DMER_HASH_BITS, 0);
+		vector<uint32_t> lastSample(static_cast<size_t>(1) << DMER_HASH_BITS, UINT32_MAX);
+
+		size_t sampleStart = 0;
+		for (size_t s = 0; s < sampleSizes.size(); s++)
+		{
+			size_t sampleEnd = sampleStart + sampleSizes[s];
+
+			for (size_t i = sampleStart; i + DMER_SIZE <= sampleEnd; i++)
+			{
+				uint32_t hash = HashDmer(samples.data() + i);
+				if (lastSample[hash] != s)
+				{
+					lastSample[hash] = static_cast<uint32_t>(s);
+					freq[hash]++;
+				}
+			}
+
+			sampleStart = sampleEnd;
+		}
+
+		//a substring of a single sample doesn't help any other file
+		for (auto& count : freq)
+		{
+			if (count < 2) count = 0;
+		}
+
+		vector<uint32_t> remaining = freq;
+		vector<uint16_t> inWindow(freq.size(), 0);
+
+		//one segment per epoch spreads the dictionary over all samples
+		size_t segmentCount = dictionarySize / SEGMENT_SIZE;
+		size_t epochSize = max(samples.size() / segmentCount, SEGMENT_SIZE);
+
+		vector<Segment> segments{};
+
+		for (size_t epochStart = 0;
+			epochStart + SEGMENT_SIZE <= samples.size()
+			&& segments.size() < segmentCount;
+			epochStart += epochSize)
+		{
+			size_t epochEnd = min(epochStart + epochSize, samples.size());
+			if (epochEnd - epochStart < SEGMENT_SIZE) break;
+
+			Segment best = FindBestSegment(
+				samples,
+				epochStart,
+				epochEnd,
+				remaining,
+				inWindow);
+
+			if (best.score == 0) continue;
+
+			segments.push_back(best);
+
+			//substrings already in the dictionary score nothing in later segments
+			for (size_t i = best.start; i + DMER_SIZE <= best.start + SEGMENT_SIZE; i++)
+			{
+				remaining[HashDmer(samples.data() + i)] = 0;
+			}
+		}
+
+		//the highest scoring segments go last, matches into them get the shortest offsets
+		stable_sort(
+			segments.begin(),
+			segments.end(),
+			[](const Segment& a, const Segment& b) { return a.score < b.score; });
+
+		vector<uint8_t> dictionary{};
+		dictionary.reserve(segments.size() * SEGMENT_SIZE);
+
+		for (const auto& segment : segments)
+		{
+			dictionary.insert(
+				dictionary.end(),
+				samples.begin() + segment.start,
+				samples.begin() + segment.start + SEGMENT_SIZE);
+		}
+
+		return dictionary;
+	}
+}
+
+uint32_t HashDmer(const uint8_t* p)
+{
+	uint64_t value{};
+	memcpy(&value, p, sizeof(uint64_t));
+
+	return static_cast<uint32_t>((value * 0x9E3779B97F4A7C15ull) >> (64 - DMER_HASH_BITS));
+}
+
+Segment FindBestSegment(
+	const vector<uint8_t>& samples,
+	size_t epochStart,
+	size_t epochEnd,
+	const vector<uint32_t>& freq,
+	vector<uint16_t>& inWindow)
+{
+	const uint8_t* data = samples.data();
+
+	//the window holds the substrings that start in [first, first + dmerCount)
+	size_t dmerCount = SEGMENT_SIZE - DMER_SIZE + 1;
+
+	Segment best{ epochStart, 0 };
+	uint64_t score = 0;
+
+	for (size_t i = epochStart; i < epochStart + dmerCount; i++)
+	{
+		uint32_t hash = HashDmer(data + i);
+		if (inWindow[hash]++ == 0) score += freq[hash];
+	}
+	best.score = score;
+
+	for (size_t first = epochStart + 1; first + SEGMENT_SIZE <= epochEnd; first++)
+	{
+		uint32_t leaving = HashDmer(data + first - 1);
+		if (--inWindow[leaving] == 0) score -= freq[leaving];
+
+		uint32_t entering = HashDmer(data + first + dmerCount - 1);
+		if (inWindow[entering]++ == 0) score += freq[entering];
+
+		if (score > best.score) best = { first, score };
+	}
+
+	//leave the window counts empty for the next epoch
+	for (size_t i = epochEnd - SEGMENT_SIZE; i < epochEnd - SEGMENT_SIZE + dmerCount; i++)
+	{
+		inWindow[HashDmer(data + i)]--;
+	}
+
+	return best;
+}
\ No newline at end of file
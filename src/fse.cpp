@@ -0,0 +1,553 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#include <algorithm>
+#include <bit>
+
+#include "core.hpp"
+#include "fse.hpp"
+#include "bitstream.hpp"
+
+using KalaData::Core;
+using KalaData::Fse;
+using KalaData::FSE_MIN_TABLE_LOG;
+using KalaData::FSE_MAX_TABLE_LOG;
+using KalaData::FSE_BLOCK_SIZE;
+using KalaData::BitReader;
+using KalaData::ReverseBitWriter;
+using KalaData::ReadVarint;
+using KalaData::WriteVarint;
+
+using std::vector;
+using std::string;
+
+using std::min;
+using std::max;
+using std::clamp;
+using std::bit_width;
+using std::countl_zero;
+
+constexpr size_t MAX_TABLE_SIZE = static_cast<size_t>(1) << FSE_MAX_TABLE_LOG;
+
+//interleaved coder states per block
+constexpr size_t FSE_STATE_COUNT = 4;
+
+//Symbol of a decoder state, the bits to read and the state they are added to
+struct DecodeEntry
+{
+	uint16_t newState;
+	uint8_t symbol;
+	uint8_t bits;
+};
+
+//Per-symbol encoder constants: the bit count is (state + deltaNbBits) >> 16,
+//the next state is stateTable[(state >> bits) + deltaFindState]
+struct SymbolTransform
+{
+	int32_t deltaFindState;
+	uint32_t deltaNbBits;
+};
+
+//Smallest table that still resolves the symbol probabilities of a block this size
+static uint32_t ChooseTableLog(
+	size_t count,
+	size_t usedSymbols);
+
+//Scales freq so the counts sum to 2^tableLog, every used symbol keeps at least 1
+static void NormalizeCounts(
+	const size_t freq[256],
+	size_t total,
+	uint32_t tableLog,
+	uint32_t norm[256]);
+
+//Scatters every symbol over the state table, norm[s] times each
+static void SpreadSymbols(
+	const uint32_t norm[256],
+	uint32_t tableLog,
+	uint8_t spread[]);
+
+//Appends one size-prefixed block with its own normalized counts to output
+static void EncodeBlock(
+	const uint8_t* symbols,
+	size_t count,
+	vector<uint8_t>& output);
+
+//Reads the size prefix of the block at pos and the symbol count at its start,
+//leaves pos at the block. False if either is damaged
+static bool ReadBlockHeader(
+	const uint8_t* data,
+	size_t size,
+	size_t& pos,
+	size_t& outBlockSize,
+	size_t& outSymbolCount,
+	const string& origin,
+	string& outError);
+
+//Decodes one block holding exactly count symbols into out
+static bool DecodeBlock(
+	const uint8_t* data,
+	size_t size,
+	uint8_t* out,
+	size_t count,
+	const string& origin,
+	string& outError);
+
+namespace KalaData
+{
+	vector<uint8_t> Fse::Encode(
+		const vector<uint8_t>& input,
+		const string& origin)
+	{
+		if (input.empty()) return {};
+
+		vector<uint8_t> output{};
+
+		for (size_t blockStart = 0; blockStart < input.size(); blockStart += FSE_BLOCK_SIZE)
+		{
+			EncodeBlock(
+				input.data() + blockStart,
+				min(FSE_BLOCK_SIZE, input.size() - blockStart),
+				output);
+		}
+
+		if (output.empty())
+		{
+			Core::ForceClose(
+				"FSE encode error",
+				"FSE encoder produced empty output for '" + origin + "'!\n");
+
+			return {};
+		}
+
+		return output;
+	}
+
+	bool Fse::DecodeNextBlock(
+		const uint8_t* data,
+		size_t size,
+		size_t& pos,
+		vector<uint8_t>& out,
+		const string& origin,
+		string& outError)
+	{
+		size_t blockSize{};
+		size_t symbolCount{};
+		if (!ReadBlockHeader(
+			data,
+			size,
+			pos,
+			blockSize,
+			symbolCount,
+			origin,
+			outError))
+		{
+			return false;
+		}
+
+		out.resize(symbolCount);
+
+		if (!DecodeBlock(
+			data + pos,
+			blockSize,
+			out.data(),
+			symbolCount,
+			origin,
+			outError))
+		{
+			return false;
+		}
+
+		pos += blockSize;
+
+		return true;
+	}
+}
+
+uint32_t ChooseTableLog(
+	size_t count,
+	size_t usedSymbols)
+{
+	//a table much larger than the block only adds header and state bits,
+	//but every used symbol needs room for at least one state
+	uint32_t tableLog = min(
+		FSE_MAX_TABLE_LOG,
+		static_cast<uint32_t>(bit_width(count)) - 1);
+
+	tableLog = max(tableLog, static_cast<uint32_t>(bit_width(usedSymbols)) + 1);
+
+	return clamp(tableLog, FSE_MIN_TABLE_LOG, FSE_MAX_TABLE_LOG);
+}
+
+void NormalizeCounts(
+	const size_t freq[256],
+	size_t total,
+	uint32_t tableLog,
+	uint32_t norm[256])
+{
+	uint64_t target = static_cast<uint64_t>(1) << tableLog;
+	uint64_t sum = 0;
+	int largest = 0;
+
+	for (int s = 0; s < 256; s++)
+	{
+		norm[s] = 0;
+		if (freq[s] == 0) continue;
+
+		uint64_t scaled = (static_cast<uint64_t>(freq[s]) * target + total / 2) / total;
+		norm[s] = static_cast<uint32_t>(max<uint64_t>(scaled, 1));
+		sum += norm[s];
+
+		if (freq[s] > freq[largest]) largest = s;
+	}
+
+	//rounding error goes to the most frequent symbol, where it costs the least
+	if (sum < target)
+	{
+		norm[largest] += static_cast<uint32_t>(target - sum);
+		return;
+	}
+
+	//rare symbols rounded up to 1 can overshoot, take it back from the largest counts
+	while (sum > target)
+	{
+		int biggest = 0;
+		for (int s = 1; s < 256; s++)
+		{
+			if (norm[s] > norm[biggest]) biggest = s;
+		}
+
+		uint32_t take = static_cast<uint32_t>(min<uint64_t>(sum - target, norm[biggest] / 2));
+		if (take == 0) take = 1;
+
+		norm[biggest] -= take;
+		sum -= take;
+	}
+}
+
+void SpreadSymbols(
+	const uint32_t norm[256],
+	uint32_t tableLog,
+	uint8_t spread[])
+{
+	//an odd step visits every slot of the power of two table exactly once
+	//and scatters the states of each symbol across the whole range
+	size_t tableSize = static_cast<size_t>(1) << tableLog;
+	size_t mask = tableSize - 1;
+	size_t step = (tableSize >> 1) + (tableSize >> 3) + 3;
+	size_t position = 0;
+
+	for (int s = 0; s < 256; s++)
+	{
+		for (uint32_t i = 0; i < norm[s]; i++)
+		{
+			spread[position] = static_cast<uint8_t>(s);
+			position = (position + step) & mask;
+		}
+	}
+}
+
+void EncodeBlock(
+	const uint8_t* symbols,
+	size_t count,
+	vector<uint8_t>& output)
+{
+	size_t freq[256]{};
+	for (size_t i = 0; i < count; i++)
+	{
+		freq[symbols[i]]++;
+	}
+
+	size_t usedSymbols = 0;
+	int lastSymbol = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		if (freq[s] == 0) continue;
+
+		usedSymbols++;
+		lastSymbol = s;
+	}
+
+	uint32_t tableLog = ChooseTableLog(count, usedSymbols);
+	uint32_t tableSize = 1u << tableLog;
+
+	uint32_t norm[256]{};
+	NormalizeCounts(freq, count, tableLog, norm);
+
+	uint8_t spread[MAX_TABLE_SIZE]{};
+	SpreadSymbols(norm, tableLog, spread);
+
+	//states of each symbol are numbered in spread order, starting at its cumulative count
+	uint32_t next[256]{};
+	uint32_t cumulative = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		next[s] = cumulative;
+		cumulative += norm[s];
+	}
+
+	uint16_t stateTable[MAX_TABLE_SIZE]{};
+	for (uint32_t u = 0; u < tableSize; u++)
+	{
+		stateTable[next[spread[u]]++] = static_cast<uint16_t>(tableSize + u);
+	}
+
+	SymbolTransform transforms[256]{};
+	int32_t start = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		if (norm[s] == 0) continue;
+
+		if (norm[s] == 1)
+		{
+			transforms[s].deltaNbBits = (tableLog << 16) - tableSize;
+			transforms[s].deltaFindState = start - 1;
+		}
+		else
+		{
+			uint32_t maxBitsOut = tableLog - (static_cast<uint32_t>(bit_width(norm[s] - 1)) - 1);
+			uint32_t minStatePlus = norm[s] << maxBitsOut;
+
+			transforms[s].deltaNbBits = (maxBitsOut << 16) - minStatePlus;
+			transforms[s].deltaFindState = start - static_cast<int32_t>(norm[s]);
+		}
+
+		start += static_cast<int32_t>(norm[s]);
+	}
+
+	vector<uint8_t> block{};
+
+	//header: symbol count, table size, highest used symbol and its normalized counts
+	WriteVarint(block, count);
+	block.push_back(static_cast<uint8_t>(tableLog));
+	block.push_back(static_cast<uint8_t>(lastSymbol));
+
+	for (int s = 0; s <= lastSymbol; s++)
+	{
+		WriteVarint(block, norm[s]);
+	}
+
+	//no symbol writes more than tableLog bits, the final state, marker and
+	//padding add at most one more symbol's worth and a byte, the writer needs
+	//8 spare bytes in front
+	size_t bound = (count + 1) * tableLog / 8 + 3;
+	vector<uint8_t> buffer(bound + sizeof(uint64_t));
+
+	//symbols are encoded last to first, the decoder gets them back first to last.
+	//Symbol i belongs to state i % 4, so the decoder can follow four independent
+	//state chains at once instead of waiting on one table lookup per symbol
+	ReverseBitWriter writer{ buffer.data() + buffer.size() };
+	uint32_t states[FSE_STATE_COUNT]{ tableSize, tableSize, tableSize, tableSize };
+
+	auto EncodeSymbol = [&](uint32_t& state, uint8_t symbol)
+		{
+			const SymbolTransform& transform = transforms[symbol];
+			uint32_t bits = (state + transform.deltaNbBits) >> 16;
+
+			writer.Put(state & ((1u << bits) - 1), bits);
+			state = stateTable[(state >> bits) + transform.deltaFindState];
+		};
+
+	//the tail that doesn't fill all four states goes first, then four symbols
+	//of at most 11 bits per flush fit next to the 7 bits a flush can leave behind
+	size_t i = count;
+	for (; i % FSE_STATE_COUNT != 0; i--)
+	{
+		EncodeSymbol(states[(i - 1) % FSE_STATE_COUNT], symbols[i - 1]);
+		writer.Flush();
+	}
+	for (; i > 0; i -= FSE_STATE_COUNT)
+	{
+		EncodeSymbol(states[3], symbols[i - 1]);
+		EncodeSymbol(states[2], symbols[i - 2]);
+		EncodeSymbol(states[1], symbols[i - 3]);
+		EncodeSymbol(states[0], symbols[i - 4]);
+		writer.Flush();
+	}
+
+	//the decoder starts from the final states, first state read first
+	for (size_t k = FSE_STATE_COUNT; k-- > 0;)
+	{
+		writer.Put(states[k] - tableSize, tableLog);
+		writer.Flush();
+	}
+	uint8_t* streamStart = writer.Finish();
+
+	block.insert(
+		block.end(),
+		streamStart,
+		buffer.data() + buffer.size());
+
+	WriteVarint(output, block.size());
+	output.insert(
+		output.end(),
+		block.begin(),
+		block.end());
+}
+
+bool ReadBlockHeader(
+	const uint8_t* data,
+	size_t size,
+	size_t& pos,
+	size_t& outBlockSize,
+	size_t& outSymbolCount,
+	const string& origin,
+	string& outError)
+{
+	uint64_t blockSize{};
+	if (!ReadVarint(data, size, pos, blockSize)
+		|| blockSize > size - pos)
+	{
+		outError = "Invalid FSE block size in '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	size_t countPos = pos;
+	uint64_t symbolCount{};
+
+	//no block holds more than FSE_BLOCK_SIZE symbols
+	if (!ReadVarint(data, pos + static_cast<size_t>(blockSize), countPos, symbolCount)
+		|| symbolCount == 0
+		|| symbolCount > FSE_BLOCK_SIZE)
+	{
+		outError = "Invalid FSE block symbol count in '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	outBlockSize = static_cast<size_t>(blockSize);
+	outSymbolCount = static_cast<size_t>(symbolCount);
+
+	return true;
+}
+
+bool DecodeBlock(
+	const uint8_t* data,
+	size_t size,
+	uint8_t* out,
+	size_t count,
+	const string& origin,
+	string& outError)
+{
+	size_t pos = 0;
+	uint64_t symbolCount{};
+
+	if (!ReadVarint(data, size, pos, symbolCount)
+		|| symbolCount != count
+		|| size - pos < 2)
+	{
+		outError = "Unexpected end of data while reading FSE header in '" + origin + "'!\n";
+		return false;
+	}
+
+	uint32_t tableLog = data[pos++];
+	uint8_t lastSymbol = data[pos++];
+
+	if (tableLog < FSE_MIN_TABLE_LOG
+		|| tableLog > FSE_MAX_TABLE_LOG)
+	{
+		outError = "Invalid FSE table size in '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	uint32_t tableSize = 1u << tableLog;
+
+	uint32_t norm[256]{};
+	uint64_t sum = 0;
+	for (int s = 0; s <= lastSymbol; s++)
+	{
+		uint64_t value{};
+		if (!ReadVarint(data, size, pos, value)
+			|| value > tableSize)
+		{
+			outError = "Invalid FSE normalized counts in '" + origin + "' (corruption suspected)!\n";
+			return false;
+		}
+
+		norm[s] = static_cast<uint32_t>(value);
+		sum += value;
+	}
+
+	if (sum != tableSize
+		|| pos >= size)
+	{
+		outError = "Invalid FSE normalized counts in '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	uint8_t spread[MAX_TABLE_SIZE]{};
+	SpreadSymbols(norm, tableLog, spread);
+
+	//the k-th state of a symbol in spread order is norm + k, the bits read
+	//after decoding it bring that value back into the table range
+	uint32_t next[256]{};
+	for (int s = 0; s < 256; s++)
+	{
+		next[s] = norm[s];
+	}
+
+	DecodeEntry table[MAX_TABLE_SIZE]{};
+	for (uint32_t u = 0; u < tableSize; u++)
+	{
+		uint8_t symbol = spread[u];
+		uint32_t x = next[symbol]++;
+		uint32_t bits = tableLog - (static_cast<uint32_t>(bit_width(x)) - 1);
+
+		table[u] = {
+			static_cast<uint16_t>((x << bits) - tableSize),
+			symbol,
+			static_cast<uint8_t>(bits) };
+	}
+
+	//the stream opens with zero padding and a 1 marker bit
+	if (data[pos] == 0)
+	{
+		outError = "Missing FSE stream marker in '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	size_t streamStart = pos;
+	size_t streamBits = (size - pos) * 8;
+
+	BitReader reader{ data, size, pos };
+	reader.Refill();
+	reader.Consume(static_cast<uint32_t>(countl_zero(data[pos])) + 1);
+
+	uint32_t states[FSE_STATE_COUNT]{};
+	for (size_t k = 0; k < FSE_STATE_COUNT; k++)
+	{
+		states[k] = reader.Read(tableLog);
+		reader.Refill();
+	}
+
+	//a refill leaves at least 56 bits, enough for one symbol of each state
+	size_t n = 0;
+	for (; n + FSE_STATE_COUNT <= count; n += FSE_STATE_COUNT)
+	{
+		reader.Refill();
+
+		for (size_t k = 0; k < FSE_STATE_COUNT; k++)
+		{
+			const DecodeEntry& entry = table[states[k]];
+			out[n + k] = entry.symbol;
+			states[k] = entry.newState + reader.Read(entry.bits);
+		}
+	}
+	for (size_t k = 0; n < count; n++, k++)
+	{
+		reader.Refill();
+
+		const DecodeEntry& entry = table[states[k]];
+		out[n] = entry.symbol;
+		states[k] = entry.newState + reader.Read(entry.bits);
+	}
+
+	//the reader pads with zeros past the end, those bits must not have been used
+	if (reader.Consumed(streamStart) > streamBits)
+	{
+		outError = "Unexpected end of FSE stream in '" + origin + "'!\n";
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,824 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#include <algorithm>
+
+#include "core.hpp"
+#include "huffman.hpp"
+#include "bitstream.hpp"
+
+using KalaData::Core;
+using KalaData::Huffman;
+using KalaData::HUFFMAN_MAX_CODE_LENGTH;
+using KalaData::HUFFMAN_FOUR_STREAM_MIN;
+using KalaData::HUFFMAN_BLOCK_SIZE;
+using KalaData::BitReader;
+using KalaData::BitWriter;
+using KalaData::ReadVarint;
+using KalaData::WriteVarint;
+
+using std::vector;
+using std::string;
+
+using std::min;
+using std::fill;
+using std::copy;
+using std::stable_sort;
+using std::to_string;
+
+constexpr uint32_t DECODE_TABLE_SIZE = 1u << HUFFMAN_MAX_CODE_LENGTH;
+
+//bytes of varints around the code lengths of a typical block
+constexpr uint64_t BLOCK_HEADER_ESTIMATE = 10;
+
+//Decoded symbols of one table probe and the bits they use, bits is 0 for invalid codes
+struct DecodeEntry
+{
+	uint8_t symbols[2];
+	uint8_t count;
+	uint8_t bits;
+};
+
+//Adds the byte frequencies of count symbols to freq
+static void CountSymbols(
+	const uint8_t* symbols,
+	size_t count,
+	size_t freq[256]);
+
+//Coded size of a block with these frequencies, including its header
+static uint64_t EstimateBlockBits(const size_t freq[256]);
+
+//Appends one size-prefixed block with its own table to output
+static void EncodeBlock(
+	const uint8_t* symbols,
+	size_t total,
+	vector<uint8_t>& output);
+
+//Reads the size prefix of the block at pos and the symbol count at its start,
+//leaves pos at the block. False if either is damaged
+static bool ReadBlockHeader(
+	const uint8_t* data,
+	size_t size,
+	size_t& pos,
+	size_t& outBlockSize,
+	size_t& outSymbolCount,
+	const string& origin,
+	string& outError);
+
+//Decodes one block holding exactly count symbols into out
+static bool DecodeBlock(
+	const uint8_t* data,
+	size_t size,
+	uint8_t* out,
+	size_t count,
+	const string& origin,
+	string& outError);
+
+//Writes count symbols as one bitstream starting at dst
+static void EncodeStream(
+	const uint8_t* symbols,
+	size_t count,
+	const uint32_t codes[256],
+	const uint8_t lengths[256],
+	uint8_t* dst);
+
+//Decodes symbols into dst until dstEnd, false on an invalid code
+static bool DecodeStream(
+	BitReader& reader,
+	const DecodeEntry* pairs,
+	const DecodeEntry* single,
+	uint8_t* dst,
+	uint8_t* dstEnd);
+
+//Assigns canonical codes: shorter codes first, equal lengths in symbol order
+static void AssignCodes(
+	const uint8_t lengths[256],
+	uint32_t codes[256]);
+
+namespace KalaData
+{
+	void Huffman::BuildCodeLengths(
+		const size_t freq[256],
+		uint8_t lengths[256],
+		uint32_t maxLength)
+	{
+		fill(lengths, lengths + 256, 0);
+
+		//used symbols sorted by rising frequency
+		uint16_t symbols[256]{};
+		size_t count = 0;
+		for (int s = 0; s < 256; s++)
+		{
+			if (freq[s] > 0) symbols[count++] = static_cast<uint16_t>(s);
+		}
+
+		if (count == 0) return;
+		if (count == 1)
+		{
+			lengths[symbols[0]] = 1;
+			return;
+		}
+
+		stable_sort(
+			symbols,
+			symbols + count,
+			[freq](uint16_t a, uint16_t b) { return freq[a] < freq[b]; });
+
+		//two-queue construction: leaves are taken in sorted order and merged
+		//nodes are created in rising weight order, so both queues stay sorted
+		size_t nodeCount = count * 2 - 1;
+		uint64_t weight[511]{};
+		uint16_t parent[511]{};
+
+		for (size_t i = 0; i < count; i++)
+		{
+			weight[i] = freq[symbols[i]];
+		}
+
+		size_t leaf = 0;
+		size_t merged = count;
+
+		auto PopSmallest = [&](size_t next)
+			{
+				if (leaf < count
+					&& (merged == next || weight[leaf] <= weight[merged]))
+				{
+					return leaf++;
+				}
+
+				return merged++;
+			};
+
+		for (size_t next = count; next < nodeCount; next++)
+		{
+			size_t a = PopSmallest(next);
+			size_t b = PopSmallest(next);
+
+			weight[next] = weight[a] + weight[b];
+			parent[a] = static_cast<uint16_t>(next);
+			parent[b] = static_cast<uint16_t>(next);
+		}
+
+		//parents are always created after their children, walk down from the root
+		uint32_t depth[511]{};
+		uint32_t lengthCount[256]{};
+		for (size_t i = nodeCount - 1; i-- > 0;)
+		{
+			depth[i] = depth[parent[i]] + 1;
+			if (i < count) lengthCount[depth[i]]++;
+		}
+
+		//cut codes above maxLength, then lengthen the deepest shorter codes
+		//one at a time until the code space is no longer oversubscribed
+		for (uint32_t len = maxLength + 1; len < 256; len++)
+		{
+			lengthCount[maxLength] += lengthCount[len];
+			lengthCount[len] = 0;
+		}
+
+		uint64_t kraft = 0;
+		for (uint32_t len = 1; len <= maxLength; len++)
+		{
+			kraft += static_cast<uint64_t>(lengthCount[len]) << (maxLength - len);
+		}
+
+		while (kraft > (static_cast<uint64_t>(1) << maxLength))
+		{
+			lengthCount[maxLength]--;
+			for (uint32_t len = maxLength - 1; len > 0; len--)
+			{
+				if (lengthCount[len] > 0)
+				{
+					lengthCount[len]--;
+					lengthCount[len + 1] += 2;
+					break;
+				}
+			}
+			kraft--;
+		}
+
+		//rarest symbols get the longest codes
+		size_t next = 0;
+		for (uint32_t len = maxLength; len > 0; len--)
+		{
+			for (uint32_t i = 0; i < lengthCount[len]; i++)
+			{
+				lengths[symbols[next++]] = static_cast<uint8_t>(len);
+			}
+		}
+	}
+
+	vector<uint8_t> Huffman::Encode(
+		const vector<uint8_t>& input,
+		const string& origin)
+	{
+		if (input.empty()) return {};
+
+		vector<uint8_t> output{};
+
+		//blocks start as HUFFMAN_BLOCK_SIZE chunks, each following chunk joins
+		//the current block while one table codes both cheaper than two tables
+		size_t blockStart = 0;
+		size_t blockEnd = min(HUFFMAN_BLOCK_SIZE, input.size());
+
+		size_t blockFreq[256]{};
+		CountSymbols(input.data(), blockEnd, blockFreq);
+
+		while (blockEnd < input.size())
+		{
+			size_t chunkEnd = min(blockEnd + HUFFMAN_BLOCK_SIZE, input.size());
+
+			size_t chunkFreq[256]{};
+			CountSymbols(input.data() + blockEnd, chunkEnd - blockEnd, chunkFreq);
+
+			size_t mergedFreq[256]{};
+			for (int s = 0; s < 256; s++)
+			{
+				mergedFreq[s] = blockFreq[s] + chunkFreq[s];
+			}
+
+			if (EstimateBlockBits(mergedFreq) > EstimateBlockBits(blockFreq) + EstimateBlockBits(chunkFreq))
+			{
+				EncodeBlock(
+					input.data() + blockStart,
+					blockEnd - blockStart,
+					output);
+
+				blockStart = blockEnd;
+				copy(chunkFreq, chunkFreq + 256, blockFreq);
+			}
+			else copy(mergedFreq, mergedFreq + 256, blockFreq);
+
+			blockEnd = chunkEnd;
+		}
+
+		EncodeBlock(
+			input.data() + blockStart,
+			blockEnd - blockStart,
+			output);
+
+
+		if (output.empty())
+		{
+			Core::ForceClose(
+				"Huffman encode error",
+				"Huffman encoder produced empty output for '" + origin + "'!\n");
+
+			return {};
+		}
+
+		return output;
+	}
+
+	bool Huffman::DecodeNextBlock(
+		const uint8_t* data,
+		size_t size,
+		size_t& pos,
+		vector<uint8_t>& out,
+		const string& origin,
+		string& outError)
+	{
+		size_t blockSize{};
+		size_t symbolCount{};
+		if (!ReadBlockHeader(
+			data,
+			size,
+			pos,
+			blockSize,
+			symbolCount,
+			origin,
+			outError))
+		{
+			return false;
+		}
+
+		out.resize(symbolCount);
+
+		if (!DecodeBlock(
+			data + pos,
+			blockSize,
+			out.data(),
+			symbolCount,
+			origin,
+			outError))
+		{
+			return false;
+		}
+
+		pos += blockSize;
+
+		return true;
+	}
+}
+
+void AssignCodes(
+	const uint8_t lengths[256],
+	uint32_t codes[256])
+{
+	uint32_t lengthCount[HUFFMAN_MAX_CODE_LENGTH + 1]{};
+	for (int s = 0; s < 256; s++)
+	{
+		if (lengths[s] > 0) lengthCount[lengths[s]]++;
+	}
+
+	uint32_t next[HUFFMAN_MAX_CODE_LENGTH + 1]{};
+	uint32_t code = 0;
+	for (uint32_t len = 1; len <= HUFFMAN_MAX_CODE_LENGTH; len++)
+	{
+		code = (code + lengthCount[len - 1]) << 1;
+		next[len] = code;
+	}
+
+	for (int s = 0; s < 256; s++)
+	{
+		if (lengths[s] > 0) codes[s] = next[lengths[s]]++;
+	}
+}
+
+void EncodeStream(
+	const uint8_t* symbols,
+	size_t count,
+	const uint32_t codes[256],
+	const uint8_t lengths[256],
+	uint8_t* dst)
+{
+	BitWriter writer{ dst };
+
+	//four codes of at most 12 bits fit next to the 7 bits a flush can leave behind
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		writer.Put(codes[symbols[i]], lengths[symbols[i]]);
+		writer.Put(codes[symbols[i + 1]], lengths[symbols[i + 1]]);
+		writer.Put(codes[symbols[i + 2]], lengths[symbols[i + 2]]);
+		writer.Put(codes[symbols[i + 3]], lengths[symbols[i + 3]]);
+		writer.Flush();
+	}
+	for (; i < count; i++)
+	{
+		writer.Put(codes[symbols[i]], lengths[symbols[i]]);
+		writer.Flush();
+	}
+}
+
+bool DecodeStream(
+	BitReader& reader,
+	const DecodeEntry* pairs,
+	const DecodeEntry* single,
+	uint8_t* dst,
+	uint8_t* dstEnd)
+{
+	//a refill leaves at least 56 bits, enough for four probes. Each probe
+	//writes two bytes, the second one is overwritten when it isn't a symbol
+	while (dstEnd - dst >= 8)
+	{
+		reader.Refill();
+
+		for (int probe = 0; probe < 4; probe++)
+		{
+			const DecodeEntry& entry = pairs[reader.Peek(HUFFMAN_MAX_CODE_LENGTH)];
+			if (entry.bits == 0) return false;
+
+			dst[0] = entry.symbols[0];
+			dst[1] = entry.symbols[1];
+			dst += entry.count;
+			reader.Consume(entry.bits);
+		}
+	}
+
+	while (dst < dstEnd)
+	{
+		reader.Refill();
+
+		const DecodeEntry& entry = single[reader.Peek(HUFFMAN_MAX_CODE_LENGTH)];
+		if (entry.bits == 0) return false;
+
+		*dst++ = entry.symbols[0];
+		reader.Consume(entry.bits);
+	}
+
+	return true;
+}
+
+
+void CountSymbols(
+	const uint8_t* symbols,
+	size_t count,
+	size_t freq[256])
+{
+	//four partial histograms so repeated bytes don't serialize on one counter
+	size_t partial[4][256]{};
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		partial[0][symbols[i]]++;
+		partial[1][symbols[i + 1]]++;
+		partial[2][symbols[i + 2]]++;
+		partial[3][symbols[i + 3]]++;
+	}
+	for (; i < count; i++)
+	{
+		partial[0][symbols[i]]++;
+	}
+
+	for (int s = 0; s < 256; s++)
+	{
+		freq[s] += partial[0][s] + partial[1][s] + partial[2][s] + partial[3][s];
+	}
+}
+
+uint64_t EstimateBlockBits(const size_t freq[256])
+{
+	uint8_t lengths[256]{};
+	Huffman::BuildCodeLengths(freq, lengths);
+
+	uint64_t bits = 0;
+	int lastSymbol = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		if (lengths[s] > 0) lastSymbol = s;
+		bits += static_cast<uint64_t>(freq[s]) * lengths[s];
+	}
+
+	//code lengths plus the size prefix, symbol count and jump table varints
+	return bits + (lastSymbol / 2 + 2 + BLOCK_HEADER_ESTIMATE) * 8;
+}
+
+void EncodeBlock(
+	const uint8_t* symbols,
+	size_t total,
+	vector<uint8_t>& output)
+{
+	//the symbols are cut into four consecutive segments, one per stream.
+	//Counting them in lock-step keeps repeated bytes from serializing
+	//on one counter and gives each stream its own histogram
+	size_t segmentSize = (total + 3) / 4;
+
+	size_t segmentStart[5]{};
+	for (size_t j = 0; j < 4; j++)
+	{
+		segmentStart[j] = min(j * segmentSize, total);
+	}
+	segmentStart[4] = total;
+
+	size_t partial[4][256]{};
+	size_t shortest = segmentStart[4] - segmentStart[3];
+	for (size_t k = 0; k < shortest; k++)
+	{
+		partial[0][symbols[segmentStart[0] + k]]++;
+		partial[1][symbols[segmentStart[1] + k]]++;
+		partial[2][symbols[segmentStart[2] + k]]++;
+		partial[3][symbols[segmentStart[3] + k]]++;
+	}
+	for (size_t j = 0; j < 3; j++)
+	{
+		for (size_t k = segmentStart[j] + shortest; k < segmentStart[j + 1]; k++)
+		{
+			partial[j][symbols[k]]++;
+		}
+	}
+
+	size_t freq[256]{};
+	for (int s = 0; s < 256; s++)
+	{
+		freq[s] = partial[0][s] + partial[1][s] + partial[2][s] + partial[3][s];
+	}
+
+	uint8_t lengths[256]{};
+	Huffman::BuildCodeLengths(freq, lengths);
+
+	uint32_t codes[256]{};
+	AssignCodes(lengths, codes);
+
+	vector<uint8_t> block{};
+
+	//header: symbol count, highest used symbol, then two 4-bit lengths per byte
+	WriteVarint(block, total);
+
+	uint8_t lastSymbol = 0;
+	uint64_t segmentBits[4]{};
+	for (int s = 0; s < 256; s++)
+	{
+		if (lengths[s] > 0) lastSymbol = static_cast<uint8_t>(s);
+
+		for (size_t j = 0; j < 4; j++)
+		{
+			segmentBits[j] += static_cast<uint64_t>(partial[j][s]) * lengths[s];
+		}
+	}
+	block.push_back(lastSymbol);
+
+	for (int s = 0; s <= lastSymbol; s += 2)
+	{
+		uint8_t high = s + 1 <= lastSymbol ? lengths[s + 1] : 0;
+		block.push_back(static_cast<uint8_t>(lengths[s] | (high << 4)));
+	}
+
+	//short inputs keep one stream, the jump table would cost more than it saves
+	size_t streamCount = total >= HUFFMAN_FOUR_STREAM_MIN ? 4 : 1;
+	size_t streamStart[5]{};
+	size_t streamBytes[4]{};
+
+	if (streamCount == 4)
+	{
+		for (size_t j = 0; j < 4; j++)
+		{
+			streamStart[j] = segmentStart[j];
+			streamBytes[j] = static_cast<size_t>((segmentBits[j] + 7) / 8);
+		}
+		streamStart[4] = total;
+
+		//jump table: byte size of the first three streams, the last one takes the rest
+		for (size_t j = 0; j < 3; j++)
+		{
+			WriteVarint(block, streamBytes[j]);
+		}
+	}
+	else
+	{
+		streamStart[1] = total;
+		streamBytes[0] = static_cast<size_t>(
+			(segmentBits[0] + segmentBits[1] + segmentBits[2] + segmentBits[3] + 7) / 8);
+	}
+
+	//the exact stream sizes are known up front, the writer needs
+	//8 spare bytes because every flush stores a whole word
+	size_t headerSize = block.size();
+	size_t bitstreamSize = streamBytes[0] + streamBytes[1] + streamBytes[2] + streamBytes[3];
+	block.resize(headerSize + bitstreamSize + sizeof(uint64_t));
+
+	//streams are written in order, so the spare bytes a stream
+	//writes past its end are overwritten by the next one
+	uint8_t* dst = block.data() + headerSize;
+	for (size_t j = 0; j < streamCount; j++)
+	{
+		EncodeStream(
+			symbols + streamStart[j],
+			streamStart[j + 1] - streamStart[j],
+			codes,
+			lengths,
+			dst);
+
+		dst += streamBytes[j];
+	}
+
+	block.resize(headerSize + bitstreamSize);
+
+	WriteVarint(output, block.size());
+	output.insert(
+		output.end(),
+		block.begin(),
+		block.end());
+}
+
+bool ReadBlockHeader(
+	const uint8_t* data,
+	size_t size,
+	size_t& pos,
+	size_t& outBlockSize,
+	size_t& outSymbolCount,
+	const string& origin,
+	string& outError)
+{
+	uint64_t blockSize{};
+	if (!ReadVarint(data, size, pos, blockSize)
+		|| blockSize > size - pos)
+	{
+		outError = "Invalid Huffman block size in '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	size_t countPos = pos;
+	uint64_t symbolCount{};
+
+	//every symbol takes at least one bit
+	if (!ReadVarint(data, pos + static_cast<size_t>(blockSize), countPos, symbolCount)
+		|| symbolCount > blockSize * 8)
+	{
+		outError = "Invalid Huffman block symbol count in '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	outBlockSize = static_cast<size_t>(blockSize);
+	outSymbolCount = static_cast<size_t>(symbolCount);
+
+	return true;
+}
+
+bool DecodeBlock(
+	const uint8_t* data,
+	size_t size,
+	uint8_t* out,
+	size_t count,
+	const string& origin,
+	string& outError)
+{
+	size_t pos = 0;
+	uint64_t symbolCount{};
+
+	if (!ReadVarint(data, size, pos, symbolCount)
+		|| symbolCount != count
+		|| pos >= size)
+	{
+		outError = "Unexpected end of data while reading Huffman header in '" + origin + "'!\n";
+		return false;
+	}
+
+	uint8_t lastSymbol = data[pos++];
+	size_t tableSize = lastSymbol / 2 + 1;
+	if (tableSize > size - pos)
+	{
+		outError = "Unexpected end of data while reading Huffman code lengths in '" + origin + "'!\n";
+		return false;
+	}
+
+	uint8_t lengths[256]{};
+	for (size_t s = 0; s <= lastSymbol; s++)
+	{
+		uint8_t packed = data[pos + s / 2];
+		lengths[s] = (s & 1) ? (packed >> 4) : (packed & 0x0F);
+	}
+	pos += tableSize;
+
+	//lengths above the limit can't come from the encoder
+	uint64_t kraft = 0;
+	size_t usedSymbols = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		if (lengths[s] == 0) continue;
+
+		if (lengths[s] > HUFFMAN_MAX_CODE_LENGTH)
+		{
+			usedSymbols = 0;
+			break;
+		}
+
+		kraft += static_cast<uint64_t>(1) << (HUFFMAN_MAX_CODE_LENGTH - lengths[s]);
+		usedSymbols++;
+	}
+
+	if (usedSymbols == 0
+		|| kraft > DECODE_TABLE_SIZE)
+	{
+		outError = "Invalid Huffman code lengths in '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	//every symbol takes at least one bit
+	size_t bitstreamSize = size - pos;
+	if (symbolCount > static_cast<uint64_t>(bitstreamSize) * 8)
+	{
+		outError = "Symbol count '" + to_string(symbolCount) + "' does not fit the Huffman bitstream in '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	//every code is a prefix of DECODE_TABLE_BITS bits, so it owns a
+	//consecutive range of table entries. Unused entries keep 0 bits
+	uint32_t codes[256]{};
+	AssignCodes(lengths, codes);
+
+	DecodeEntry single[DECODE_TABLE_SIZE]{};
+	for (int s = 0; s < 256; s++)
+	{
+		if (lengths[s] == 0) continue;
+
+		uint32_t spare = HUFFMAN_MAX_CODE_LENGTH - lengths[s];
+		uint32_t first = codes[s] << spare;
+
+		for (uint32_t i = 0; i < (1u << spare); i++)
+		{
+			single[first + i] = { { static_cast<uint8_t>(s), 0 }, 1, lengths[s] };
+		}
+	}
+
+	//a second symbol joins the entry when its code fits in the bits the first one left over
+	DecodeEntry pairs[DECODE_TABLE_SIZE]{};
+	for (uint32_t i = 0; i < DECODE_TABLE_SIZE; i++)
+	{
+		DecodeEntry entry = single[i];
+
+		if (entry.bits > 0)
+		{
+			const DecodeEntry& next = single[(i << entry.bits) & (DECODE_TABLE_SIZE - 1)];
+			if (next.bits > 0
+				&& entry.bits + next.bits <= HUFFMAN_MAX_CODE_LENGTH)
+			{
+				entry.symbols[1] = next.symbols[0];
+				entry.count = 2;
+				entry.bits = static_cast<uint8_t>(entry.bits + next.bits);
+			}
+		}
+
+		pairs[i] = entry;
+	}
+
+	//jump table, the last stream takes the rest of the data
+	size_t total = static_cast<size_t>(symbolCount);
+	size_t streamCount = total >= HUFFMAN_FOUR_STREAM_MIN ? 4 : 1;
+	size_t streamBytes[4]{};
+
+	for (size_t j = 0; j + 1 < streamCount; j++)
+	{
+		uint64_t value{};
+		if (!ReadVarint(data, size, pos, value)
+			|| value > size - pos)
+		{
+			outError = "Invalid Huffman jump table in '" + origin + "' (corruption suspected)!\n";
+			return false;
+		}
+
+		streamBytes[j] = static_cast<size_t>(value);
+	}
+
+	size_t jumpTotal = streamBytes[0] + streamBytes[1] + streamBytes[2];
+	if (jumpTotal > size - pos)
+	{
+		outError = "Invalid Huffman jump table in '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+	streamBytes[streamCount - 1] = size - pos - jumpTotal;
+
+	//same segments as the encoder: four of equal size, the last one shorter
+	size_t segmentSize = streamCount == 4 ? (total + 3) / 4 : total;
+
+	BitReader readers[4]{};
+	uint8_t* dst[4]{};
+	uint8_t* dstEnd[4]{};
+
+	size_t start = pos;
+	for (size_t j = 0; j < streamCount; j++)
+	{
+		readers[j] = { data, start + streamBytes[j], start };
+		dst[j] = out + min(j * segmentSize, total);
+		dstEnd[j] = out + min((j + 1) * segmentSize, total);
+		start += streamBytes[j];
+	}
+	dstEnd[streamCount - 1] = out + total;
+
+	//the four streams advance together so their table lookups and
+	//refills overlap instead of waiting on one chain of bit positions
+	bool valid = true;
+	if (streamCount == 4)
+	{
+		while (valid
+			&& dstEnd[0] - dst[0] >= 8
+			&& dstEnd[1] - dst[1] >= 8
+			&& dstEnd[2] - dst[2] >= 8
+			&& dstEnd[3] - dst[3] >= 8)
+		{
+			for (size_t j = 0; j < 4; j++)
+			{
+				readers[j].Refill();
+			}
+
+			for (int probe = 0; probe < 4; probe++)
+			{
+				for (size_t j = 0; j < 4; j++)
+				{
+					const DecodeEntry& entry = pairs[readers[j].Peek(HUFFMAN_MAX_CODE_LENGTH)];
+					valid &= entry.bits != 0;
+
+					dst[j][0] = entry.symbols[0];
+					dst[j][1] = entry.symbols[1];
+					dst[j] += entry.count;
+					readers[j].Consume(entry.bits);
+				}
+			}
+		}
+	}
+
+	for (size_t j = 0; j < streamCount && valid; j++)
+	{
+		valid = DecodeStream(
+			readers[j],
+			pairs,
+			single,
+			dst[j],
+			dstEnd[j]);
+	}
+
+	if (!valid)
+	{
+		outError = "Invalid code in Huffman bitstream in '" + origin + "'!\n";
+		return false;
+	}
+
+	//the readers pad with zeros past their stream, those bits must not have been used
+	bool overrun = false;
+	start = pos;
+	for (size_t j = 0; j < streamCount; j++)
+	{
+		overrun |= readers[j].Consumed(start) > streamBytes[j] * 8;
+		start += streamBytes[j];
+	}
+
+	if (overrun)
+	{
+		outError = "Unexpected end of Huffman bitstream in '" + origin + "'!\n";
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "longmatch.hpp"
+#include "matchfinder.hpp"
+
+using KalaData::LongMatchFinder;
+using KalaData::LongMatch;
+using KalaData::LONG_MATCH_MIN;
+using KalaData::LONG_MATCH_MIN_STRIDE_LOG;
+using KalaData::MatchFinder;
+
+using std::max;
+using std::bit_floor;
+using std::bit_width;
+using std::countr_zero;
+using std::memcmp;
+
+constexpr uint64_t ROLL_PRIME = 0x100000001B3ull;
+constexpr uint64_t MIX_PRIME = 0x9E3779B97F4A7C15ull;
+
+//Sampled position and the low hash bits that must match before the bytes are compared
+struct LongEntry
+{
+	uint32_t pos;
+	uint32_t check;
+};
+
+//ROLL_PRIME^LONG_MATCH_MIN, removes the byte that leaves the rolling hash
+static uint64_t RollOutFactor();
+
+//Spreads the rolling hash over all 64 bits
+static uint64_t Mix(uint64_t hash);
+
+namespace KalaData
+{
+	vector<LongMatch> LongMatchFinder::Find(
+		const vector<uint8_t>& input,
+		size_t windowSize,
+		size_t memory)
+	{
+		vector<LongMatch> matches{};
+
+		size_t size = input.size();
+		if (size <= windowSize
+			|| size < LONG_MATCH_MIN * 2
+			|| memory < sizeof(LongEntry))
+		{
+			return matches;
+		}
+
+		size_t entryCount = bit_floor(memory / sizeof(LongEntry));
+		uint32_t tableBits = static_cast<uint32_t>(countr_zero(entryCount));
+
+		//one sample per stride keeps the whole input within reach of the table
+		uint32_t strideLog = max(
+			LONG_MATCH_MIN_STRIDE_LOG,
+			static_cast<uint32_t>(bit_width(size >> tableBits)));
+
+		vector<LongEntry> table(entryCount, LongEntry{});
+
+		const uint8_t* data = input.data();
+		uint64_t rollOut = RollOutFactor();
+
+		uint64_t hash = 0;
+		for (size_t i = 0; i < LONG_MATCH_MIN; i++)
+		{
+			hash = hash * ROLL_PRIME + data[i];
+		}
+
+		//matches don't overlap, positions before matchEnd are only indexed
+		size_t matchEnd = 0;
+
+		for (size_t pos = 0; ; pos++)
+		{
+			uint64_t mixed = Mix(hash);
+
+			//the top bits pick the sampled positions, the bits below them the table entry
+			if ((mixed >> (64 - strideLog)) == 0)
+			{
+				LongEntry& entry = table[(mixed >> (64 - strideLog - tableBits)) & (entryCount - 1)];
+				uint32_t check = static_cast<uint32_t>(hash);
+
+				if (pos >= matchEnd
+					&& entry.check == check)
+				{
+					//positions are stored truncated to 32 bits like in the hash chain,
+					//so distances wrap around and always fit a token offset
+					size_t distance = static_cast<uint32_t>(static_cast<uint32_t>(pos) - entry.pos);
+
+					if (distance > windowSize
+						&& distance <= pos
+						&& memcmp(data + pos, data + pos - distance, LONG_MATCH_MIN) == 0)
+					{
+						size_t start = pos;
+						while (start > matchEnd
+							&& start > distance
+							&& data[start - 1] == data[start - 1 - distance])
+						{
+							start--;
+						}
+
+						size_t end = pos + LONG_MATCH_MIN;
+						end += MatchFinder::MatchLength(
+							data + end - distance,
+							data + end,
+							size - end);
+
+						matches.push_back({ start, distance, end - start });
+						matchEnd = end;
+					}
+				}
+
+				entry = { static_cast<uint32_t>(pos), check };
+			}
+
+			if (pos + LONG_MATCH_MIN >= size) break;
+
+			hash = hash * ROLL_PRIME
+				+ data[pos + LONG_MATCH_MIN]
+				- data[pos] * rollOut;
+		}
+
+		return matches;
+	}
+}
+
+uint64_t RollOutFactor()
+{
+	uint64_t factor = 1;
+	for (size_t i = 0; i < LONG_MATCH_MIN; i++)
+	{
+		factor *= ROLL_PRIME;
+	}
+
+	return factor;
+}
+
+uint64_t Mix(uint64_t hash)
+{
+	return (hash ^ (hash >> 29)) * MIX_PRIME;
+}
\ No newline at end of file
@@ -0,0 +1,401 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#include <algorithm>
+#include <bit>
+
+#include "matchfinder.hpp"
+#include "compress.hpp"
+
+using KalaData::MatchFinder;
+using KalaData::MatchFinderType;
+using KalaData::HashChain;
+using KalaData::BinaryTree;
+using KalaData::Match;
+using KalaData::MIN_MATCH;
+
+using std::min;
+using std::clamp;
+using std::bit_ceil;
+using std::countr_zero;
+using std::make_unique;
+
+//largest hash chain table is 2^20 entries, 3-byte keys don't benefit from more
+constexpr uint32_t MAX_HASH_BITS = 20;
+
+//binary tree root table stays between 2^16 and 2^22 entries
+constexpr uint32_t MIN_TREE_HASH_BITS = 16;
+constexpr uint32_t MAX_TREE_HASH_BITS = 22;
+
+constexpr uint32_t HASH3_BITS = 16;
+
+constexpr uint32_t EMPTY_POS = UINT32_MAX;
+
+//rebase binary tree positions well before they reach EMPTY_POS
+constexpr size_t NORMALIZE_LIMIT = static_cast<size_t>(UINT32_MAX) - (static_cast<size_t>(1) << 24);
+
+static uint32_t Read3(const uint8_t* p);
+
+static uint32_t Read4(const uint8_t* p);
+
+namespace KalaData
+{
+	unique_ptr<MatchFinder> MatchFinder::Create(
+		MatchFinderType type,
+		const vector<uint8_t>& input,
+		size_t windowSize,
+		size_t lookAhead,
+		size_t maxDepth)
+	{
+		if (type == MatchFinderType::MATCHFINDER_BINARY_TREE)
+		{
+			return make_unique<BinaryTree>(
+				input,
+				windowSize,
+				lookAhead,
+				maxDepth);
+		}
+
+		return make_unique<HashChain>(
+			input,
+			windowSize,
+			lookAhead,
+			maxDepth);
+	}
+
+	size_t MatchFinder::FindMatch(
+		size_t pos,
+		size_t& outOffset)
+	{
+		size_t length = FindMatches(pos, scratch);
+
+		outOffset = length > 0
+			? scratch.back().offset
+			: 0;
+
+		return length;
+	}
+
+	HashChain::HashChain(
+		const vector<uint8_t>& input,
+		size_t windowSize,
+		size_t lookAhead,
+		size_t maxChain) :
+		data(input.data()),
+		size(input.size()),
+		windowSize(windowSize),
+		lookAhead(lookAhead),
+		maxChain(maxChain)
+	{
+		size_t tableSize = bit_ceil(windowSize);
+		uint32_t hashBits = min(static_cast<uint32_t>(countr_zero(tableSize)), MAX_HASH_BITS);
+
+		hashShift = 32 - hashBits;
+		prevMask = tableSize - 1;
+
+		head.assign(static_cast<size_t>(1) << hashBits, 0);
+		prev.assign(tableSize, 0);
+	}
+
+	uint32_t HashChain::Hash(size_t pos) const
+	{
+		return (Read3(data + pos) * 2654435761u) >> hashShift;
+	}
+
+	void HashChain::Skip(size_t pos)
+	{
+		if (pos + MIN_MATCH > size) return;
+
+		uint32_t h = Hash(pos);
+		prev[pos & prevMask] = head[h];
+		head[h] = static_cast<uint32_t>(pos);
+	}
+
+	unique_ptr<MatchFinder> HashChain::Clone(const vector<uint8_t>& input) const
+	{
+		auto copy = make_unique<HashChain>(*this);
+		copy->data = input.data();
+		copy->size = input.size();
+
+		return copy;
+	}
+
+	size_t HashChain::FindMatches(
+		size_t pos,
+		vector<Match>& matches)
+	{
+		matches.clear();
+
+		if (pos + MIN_MATCH > size) return 0;
+
+		size_t maxLength = min(lookAhead, size - pos);
+		size_t bestLength = MIN_MATCH - 1;
+
+		//positions are stored truncated to 32 bits, distances are
+		//computed with wrap-around so files above 4GB still work
+		uint32_t current = static_cast<uint32_t>(pos);
+		uint32_t candidate = head[Hash(pos)];
+		size_t lastDistance = 0;
+		size_t chainLimit = maxChain;
+
+		for (size_t chain = 0; chain < chainLimit; chain++)
+		{
+			size_t distance = static_cast<uint32_t>(current - candidate);
+
+			//chains only ever walk backwards, anything else is a stale entry
+			if (distance <= lastDistance
+				|| distance > windowSize
+				|| distance > pos)
+			{
+				break;
+			}
+
+			size_t matchPos = pos - distance;
+
+			//cheap reject: a longer match must also match at the current best length
+			if (data[matchPos + bestLength] == data[pos + bestLength])
+			{
+				size_t length = MatchLength(
+					data + matchPos,
+					data + pos,
+					maxLength);
+
+				if (length > bestLength)
+				{
+					bestLength = length;
+					matches.push_back({ length, distance });
+
+					if (length == maxLength) break;
+
+					//a good match is already in hand, only look a little further
+					if (length >= lookAhead / 2)
+					{
+						chainLimit = min(chainLimit, chain + maxChain / 4 + 1);
+					}
+				}
+			}
+
+			lastDistance = distance;
+			candidate = prev[matchPos & prevMask];
+		}
+
+		Skip(pos);
+
+		return matches.empty() ? 0 : bestLength;
+	}
+
+	BinaryTree::BinaryTree(
+		const vector<uint8_t>& input,
+		size_t windowSize,
+		size_t lookAhead,
+		size_t maxDepth) :
+		data(input.data()),
+		size(input.size()),
+		windowSize(windowSize),
+		lookAhead(lookAhead),
+		maxDepth(maxDepth),
+		cyclicSize(windowSize + 1)
+	{
+		uint32_t hashBits = clamp(
+			static_cast<uint32_t>(countr_zero(bit_ceil(windowSize))),
+			MIN_TREE_HASH_BITS,
+			MAX_TREE_HASH_BITS);
+
+		hashShift = 32 - hashBits;
+
+		head3.assign(static_cast<size_t>(1) << HASH3_BITS, EMPTY_POS);
+		head4.assign(static_cast<size_t>(1) << hashBits, EMPTY_POS);
+		son.assign(cyclicSize * 2, EMPTY_POS);
+	}
+
+	size_t BinaryTree::FindMatches(
+		size_t pos,
+		vector<Match>& matches)
+	{
+		matches.clear();
+		return Search(pos, &matches);
+	}
+
+	void BinaryTree::Skip(size_t pos)
+	{
+		Search(pos, nullptr);
+	}
+
+	unique_ptr<MatchFinder> BinaryTree::Clone(const vector<uint8_t>& input) const
+	{
+		auto copy = make_unique<BinaryTree>(*this);
+		copy->data = input.data();
+		copy->size = input.size();
+
+		return copy;
+	}
+
+	size_t BinaryTree::Search(
+		size_t pos,
+		vector<Match>* matches)
+	{
+		size_t remaining = size - pos;
+		if (remaining < MIN_MATCH)
+		{
+			Advance(pos);
+			return 0;
+		}
+
+		size_t lenLimit = min(lookAhead, remaining);
+		uint32_t current = static_cast<uint32_t>(pos - base);
+		size_t bestLength = MIN_MATCH - 1;
+
+		//short matches come from the newest position sharing the first 3 bytes
+		uint32_t h3 = (Read3(data + pos) * 2654435761u) >> (32 - HASH3_BITS);
+		uint32_t candidate3 = head3[h3];
+		head3[h3] = current;
+
+		if (candidate3 != EMPTY_POS)
+		{
+			size_t distance = current - candidate3;
+			if (distance > 0
+				&& distance <= windowSize)
+			{
+				size_t length = MatchLength(
+					data + pos - distance,
+					data + pos,
+					lenLimit);
+
+				if (length > bestLength)
+				{
+					bestLength = length;
+					if (matches) matches->push_back({ length, distance });
+				}
+			}
+		}
+
+		//the trees are keyed by 4 bytes, the last 3 bytes of the input never enter them
+		if (remaining < 4)
+		{
+			Advance(pos);
+			return bestLength >= MIN_MATCH ? bestLength : 0;
+		}
+
+		uint32_t h4 = (Read4(data + pos) * 2654435761u) >> hashShift;
+		uint32_t candidate = head4[h4];
+		head4[h4] = current;
+
+		//ptr0 collects the subtree of smaller suffixes, ptr1 the larger ones
+		uint32_t* ptr0 = &son[(cyclicPos << 1) + 1];
+		uint32_t* ptr1 = &son[cyclicPos << 1];
+		size_t len0 = 0;
+		size_t len1 = 0;
+
+		const uint8_t* cur = data + pos;
+
+		for (size_t depth = maxDepth; ; depth--)
+		{
+			size_t distance = static_cast<uint32_t>(current - candidate);
+
+			if (candidate == EMPTY_POS
+				|| depth == 0
+				|| distance == 0
+				|| distance > windowSize)
+			{
+				*ptr0 = EMPTY_POS;
+				*ptr1 = EMPTY_POS;
+				break;
+			}
+
+			size_t pairPos = cyclicPos >= distance
+				? cyclicPos - distance
+				: cyclicPos - distance + cyclicSize;
+			uint32_t* pair = &son[pairPos << 1];
+
+			const uint8_t* pb = cur - distance;
+
+			//both subtrees already share min(len0, len1) bytes with cur
+			size_t length = min(len0, len1);
+
+			if (pb[length] == cur[length])
+			{
+				length += MatchLength(
+					pb + length,
+					cur + length,
+					lenLimit - length);
+
+				if (length > bestLength)
+				{
+					bestLength = length;
+					if (matches) matches->push_back({ length, distance });
+				}
+
+				//full match: cur replaces the node and inherits its children
+				if (length == lenLimit)
+				{
+					*ptr1 = pair[0];
+					*ptr0 = pair[1];
+					break;
+				}
+			}
+
+			if (pb[length] < cur[length])
+			{
+				*ptr1 = candidate;
+				ptr1 = pair + 1;
+				candidate = *ptr1;
+				len1 = length;
+			}
+			else
+			{
+				*ptr0 = candidate;
+				ptr0 = pair;
+				candidate = *ptr0;
+				len0 = length;
+			}
+		}
+
+		Advance(pos);
+
+		return bestLength >= MIN_MATCH ? bestLength : 0;
+	}
+
+	void BinaryTree::Advance(size_t pos)
+	{
+		if (++cyclicPos == cyclicSize) cyclicPos = 0;
+
+		if (pos + 1 - base >= NORMALIZE_LIMIT) Normalize(pos + 1);
+	}
+
+	void BinaryTree::Normalize(size_t pos)
+	{
+		//keep exactly one window of history, everything older becomes empty
+		uint32_t shift = static_cast<uint32_t>(pos - base - cyclicSize);
+
+		auto Rebase = [shift](vector<uint32_t>& table)
+			{
+				for (auto& value : table)
+				{
+					value = (value == EMPTY_POS || value < shift)
+						? EMPTY_POS
+						: value - shift;
+				}
+			};
+
+		Rebase(head3);
+		Rebase(head4);
+		Rebase(son);
+
+		base += shift;
+	}
+}
+
+uint32_t Read3(const uint8_t* p)
+{
+	return static_cast<uint32_t>(p[0])
+		| (static_cast<uint32_t>(p[1]) << 8)
+		| (static_cast<uint32_t>(p[2]) << 16);
+}
+
+uint32_t Read4(const uint8_t* p)
+{
+	return Read3(p)
+		| (static_cast<uint32_t>(p[3]) << 24);
+}
\ No newline at end of file
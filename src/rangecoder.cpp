@@ -0,0 +1,747 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#include <algorithm>
+#include <memory>
+#include <cstring>
+
+#include "core.hpp"
+#include "rangecoder.hpp"
+#include "compress.hpp"
+#include "tokenstreams.hpp"
+
+using KalaData::Core;
+using KalaData::RangeCoder;
+using KalaData::MIN_MATCH;
+using KalaData::OffsetSlot;
+using KalaData::OffsetExtraBits;
+using KalaData::OffsetBase;
+using KalaData::Token;
+using KalaData::TokenReader;
+using KalaData::RepHistory;
+using KalaData::REP_COUNT;
+using KalaData::LENGTH_ESCAPE_BITS;
+
+using std::vector;
+using std::string;
+using std::to_string;
+
+using std::min;
+using std::make_unique;
+using std::memcpy;
+
+//probabilities are 11-bit, each update moves them 1/32 of the way to the coded bit
+constexpr uint32_t PROB_BITS = 11;
+constexpr uint32_t PROB_MOVE_BITS = 5;
+constexpr uint16_t PROB_INIT = 1 << (PROB_BITS - 1);
+
+//the range is renormalized a byte at a time once it drops below 2^24
+constexpr uint32_t RANGE_TOP = 1u << 24;
+
+//token history states: the last two tokens, literal or match
+constexpr size_t STATE_COUNT = 4;
+//low bits of the output position, separates aligned binary fields
+constexpr size_t POS_STATE_COUNT = 4;
+//literal contexts are the high 3 bits of the previous byte
+constexpr uint32_t LITERAL_CONTEXT_SHIFT = 5;
+constexpr size_t LITERAL_CONTEXT_COUNT = 8;
+
+//match lengths minus MIN_MATCH: 0-7 low, 8-15 mid, 16-270 high,
+//the last high symbol escapes to LENGTH_ESCAPE_BITS direct bits
+constexpr uint32_t LENGTH_LOW_BITS = 3;
+constexpr uint32_t LENGTH_MID_BITS = 3;
+constexpr uint32_t LENGTH_HIGH_BITS = 8;
+constexpr uint32_t LENGTH_LOW_COUNT = 1u << LENGTH_LOW_BITS;
+constexpr uint32_t LENGTH_MID_COUNT = 1u << LENGTH_MID_BITS;
+constexpr uint32_t LENGTH_HIGH_ESCAPE = (1u << LENGTH_HIGH_BITS) - 1;
+
+//repeat offset indices are coded as a 2-bit tree
+constexpr uint32_t REP_INDEX_BITS = 2;
+
+//offset slots are coded as a 6-bit tree
+constexpr uint32_t SLOT_BITS = 6;
+constexpr size_t LENGTH_STATE_COUNT = 4;
+//slots below this code their extra bits with per-slot models
+constexpr uint32_t END_MODELLED_SLOT = 14;
+constexpr uint32_t FULL_MODELLED_DISTANCES = 1u << (END_MODELLED_SLOT >> 1);
+//the lowest extra bits of large offsets keep their own models
+constexpr uint32_t ALIGN_BITS = 4;
+
+struct Prob
+{
+	uint16_t value = PROB_INIT;
+};
+
+struct LengthModel
+{
+	Prob choice{};
+	Prob choice2{};
+	Prob low[POS_STATE_COUNT][LENGTH_LOW_COUNT]{};
+	Prob mid[POS_STATE_COUNT][LENGTH_MID_COUNT]{};
+	Prob high[1u << LENGTH_HIGH_BITS]{};
+};
+
+//Every adaptive model of one file, all start at even odds
+struct TokenModel
+{
+	Prob isMatch[STATE_COUNT][POS_STATE_COUNT]{};
+	Prob isRep[STATE_COUNT]{};
+	Prob repIndex[STATE_COUNT][REP_COUNT]{};
+	Prob literal[LITERAL_CONTEXT_COUNT][0x300]{};
+	LengthModel length{};
+	LengthModel repLength{};
+	Prob slot[LENGTH_STATE_COUNT][1u << SLOT_BITS]{};
+	Prob modelled[1 + FULL_MODELLED_DISTANCES - END_MODELLED_SLOT]{};
+	Prob align[1u << ALIGN_BITS]{};
+};
+
+//Carry-propagating range encoder, low keeps one byte of headroom for the carry
+struct RangeEncoder
+{
+	vector<uint8_t>& out;
+	uint64_t low = 0;
+	uint32_t range = UINT32_MAX;
+	uint8_t cache = 0;
+	uint64_t cacheSize = 1;
+
+	void ShiftLow()
+	{
+		//the top byte is settled once it can no longer receive a carry
+		if (static_cast<uint32_t>(low) < 0xFF000000u
+			|| (low >> 32) != 0)
+		{
+			uint8_t carry = static_cast<uint8_t>(low >> 32);
+			uint8_t temp = cache;
+
+			do
+			{
+				out.push_back(static_cast<uint8_t>(temp + carry));
+				temp = 0xFF;
+			} while (--cacheSize != 0);
+
+			cache = static_cast<uint8_t>(low >> 24);
+		}
+
+		cacheSize++;
+		low = (low & 0x00FFFFFFu) << 8;
+	}
+
+	void EncodeBit(
+		Prob& prob,
+		uint32_t bit)
+	{
+		uint32_t bound = (range >> PROB_BITS) * prob.value;
+
+		if (bit == 0)
+		{
+			range = bound;
+			prob.value += ((1u << PROB_BITS) - prob.value) >> PROB_MOVE_BITS;
+		}
+		else
+		{
+			low += bound;
+			range -= bound;
+			prob.value -= prob.value >> PROB_MOVE_BITS;
+		}
+
+		while (range < RANGE_TOP)
+		{
+			range <<= 8;
+			ShiftLow();
+		}
+	}
+
+	//Codes the low bits of value at even odds, highest bit first
+	void EncodeDirect(
+		uint32_t value,
+		uint32_t bits)
+	{
+		while (bits-- > 0)
+		{
+			range >>= 1;
+			if ((value >> bits) & 1) low += range;
+
+			while (range < RANGE_TOP)
+			{
+				range <<= 8;
+				ShiftLow();
+			}
+		}
+	}
+
+	void Flush()
+	{
+		for (int i = 0; i < 5; i++) ShiftLow();
+	}
+};
+
+//Mirror of RangeEncoder, reads zeros past the end and lets the caller check pos
+struct RangeDecoder
+{
+	const uint8_t* data;
+	size_t size;
+	size_t pos = 0;
+	uint32_t code = 0;
+	uint32_t range = UINT32_MAX;
+
+	uint8_t NextByte()
+	{
+		uint8_t value = pos < size ? data[pos] : 0;
+		pos++;
+
+		return value;
+	}
+
+	void Init()
+	{
+		for (int i = 0; i < 5; i++) code = (code << 8) | NextByte();
+	}
+
+	uint32_t DecodeBit(Prob& prob)
+	{
+		uint32_t bound = (range >> PROB_BITS) * prob.value;
+		uint32_t bit{};
+
+		if (code < bound)
+		{
+			range = bound;
+			prob.value += ((1u << PROB_BITS) - prob.value) >> PROB_MOVE_BITS;
+			bit = 0;
+		}
+		else
+		{
+			code -= bound;
+			range -= bound;
+			prob.value -= prob.value >> PROB_MOVE_BITS;
+			bit = 1;
+		}
+
+		if (range < RANGE_TOP)
+		{
+			range <<= 8;
+			code = (code << 8) | NextByte();
+		}
+
+		return bit;
+	}
+
+	uint32_t DecodeDirect(uint32_t bits)
+	{
+		uint32_t value = 0;
+
+		while (bits-- > 0)
+		{
+			range >>= 1;
+			uint32_t bit = code >= range ? 1 : 0;
+			code -= range & (0u - bit);
+			value = (value << 1) | bit;
+
+			if (range < RANGE_TOP)
+			{
+				range <<= 8;
+				code = (code << 8) | NextByte();
+			}
+		}
+
+		return value;
+	}
+};
+
+//Codes the low bits of value through a binary tree of adaptive models, highest bit first
+static void EncodeTree(
+	RangeEncoder& rc,
+	Prob* probs,
+	uint32_t bits,
+	uint32_t value);
+
+static uint32_t DecodeTree(
+	RangeDecoder& rc,
+	Prob* probs,
+	uint32_t bits);
+
+//Same as EncodeTree with the lowest bit first, extra offset bits are more uniform at the top
+static void EncodeReverseTree(
+	RangeEncoder& rc,
+	Prob* probs,
+	uint32_t bits,
+	uint32_t value);
+
+static uint32_t DecodeReverseTree(
+	RangeDecoder& rc,
+	Prob* probs,
+	uint32_t bits);
+
+//Codes a literal, while its bits agree with matchByte they use the matched half of probs
+static void EncodeLiteral(
+	RangeEncoder& rc,
+	Prob* probs,
+	uint32_t symbol,
+	bool matched,
+	uint32_t matchByte);
+
+static uint8_t DecodeLiteral(
+	RangeDecoder& rc,
+	Prob* probs,
+	bool matched,
+	uint32_t matchByte);
+
+static void EncodeLength(
+	RangeEncoder& rc,
+	LengthModel& model,
+	uint32_t value,
+	size_t posState);
+
+static uint32_t DecodeLength(
+	RangeDecoder& rc,
+	LengthModel& model,
+	size_t posState);
+
+//Codes distance (offset - 1) as a slot followed by its extra bits
+static void EncodeDistance(
+	RangeEncoder& rc,
+	TokenModel& model,
+	uint32_t distance,
+	uint32_t lengthValue);
+
+static uint32_t DecodeDistance(
+	RangeDecoder& rc,
+	TokenModel& model,
+	uint32_t lengthValue);
+
+namespace KalaData
+{
+	vector<uint8_t> RangeCoder::Encode(
+		const vector<uint8_t>& lzssStream,
+		const vector<uint8_t>& input,
+		size_t start,
+		const string& origin)
+	{
+		vector<uint8_t> output{};
+		output.reserve(lzssStream.size() / 2 + 16);
+
+		auto model = make_unique<TokenModel>();
+		RangeEncoder rc{ output };
+
+		size_t state = 0;
+		RepHistory reps{};
+		size_t outPos = start;
+
+		TokenReader reader{ lzssStream };
+		Token token{};
+
+		while (reader.Next(token))
+		{
+			size_t posState = outPos & (POS_STATE_COUNT - 1);
+
+			if (token.isLiteral)
+			{
+				uint32_t prevByte = outPos > 0 ? input[outPos - 1] : 0;
+
+				//right after a match the byte at the last offset is the best guess
+				bool matched = (state & 1) != 0;
+				uint32_t matchByte = matched ? input[outPos - reps.offsets[0]] : 0;
+
+				rc.EncodeBit(model->isMatch[state][posState], 0);
+				EncodeLiteral(
+					rc,
+					model->literal[prevByte >> LITERAL_CONTEXT_SHIFT],
+					token.literal,
+					matched,
+					matchByte);
+
+				state = (state << 1) & (STATE_COUNT - 1);
+				outPos++;
+			}
+			else
+			{
+				uint32_t lengthValue = token.length - MIN_MATCH;
+
+				rc.EncodeBit(model->isMatch[state][posState], 1);
+
+				uint32_t repIndex = reps.Update(token.offset);
+
+				if (repIndex < REP_COUNT)
+				{
+					rc.EncodeBit(model->isRep[state], 1);
+					EncodeTree(rc, model->repIndex[state], REP_INDEX_BITS, repIndex);
+					EncodeLength(
+						rc,
+						model->repLength,
+						lengthValue,
+						posState);
+				}
+				else
+				{
+					rc.EncodeBit(model->isRep[state], 0);
+					EncodeLength(
+						rc,
+						model->length,
+						lengthValue,
+						posState);
+					EncodeDistance(
+						rc,
+						*model,
+						token.offset - 1,
+						lengthValue);
+				}
+
+				state = ((state << 1) | 1) & (STATE_COUNT - 1);
+				outPos += token.length;
+			}
+		}
+
+		rc.Flush();
+
+		if (outPos != input.size())
+		{
+			Core::ForceClose(
+				"Range encode error",
+				"LZSS tokens do not cover the input of '" + origin + "'!\n");
+
+			return {};
+		}
+
+		return output;
+	}
+
+	vector<uint8_t> RangeCoder::Decode(
+		const uint8_t* data,
+		size_t size,
+		size_t originalSize,
+		const vector<uint8_t>& dictionary,
+		const string& origin,
+		string& outError)
+	{
+		if (originalSize == 0) return {};
+
+		//the dictionary is decoded in front of the data and dropped afterwards
+		size_t start = dictionary.size();
+		size_t end = start + originalSize;
+
+		vector<uint8_t> out(end + WILDCOPY_OVERLENGTH);
+		uint8_t* dst = out.data();
+		if (start > 0) memcpy(dst, dictionary.data(), start);
+
+		auto model = make_unique<TokenModel>();
+		RangeDecoder rc{ data, size };
+		rc.Init();
+
+		size_t state = 0;
+		RepHistory reps{};
+		size_t outPos = start;
+
+		while (outPos < end)
+		{
+			size_t posState = outPos & (POS_STATE_COUNT - 1);
+
+			if (rc.DecodeBit(model->isMatch[state][posState]) == 0)
+			{
+				uint32_t prevByte = outPos > 0 ? dst[outPos - 1] : 0;
+
+				bool matched = (state & 1) != 0;
+				uint32_t matchByte = matched ? dst[outPos - reps.offsets[0]] : 0;
+
+				dst[outPos++] = DecodeLiteral(
+					rc,
+					model->literal[prevByte >> LITERAL_CONTEXT_SHIFT],
+					matched,
+					matchByte);
+
+				state = (state << 1) & (STATE_COUNT - 1);
+				continue;
+			}
+
+			uint32_t lengthValue{};
+
+			if (rc.DecodeBit(model->isRep[state]) == 1)
+			{
+				reps.Use(DecodeTree(rc, model->repIndex[state], REP_INDEX_BITS));
+
+				lengthValue = DecodeLength(
+					rc,
+					model->repLength,
+					posState);
+			}
+			else
+			{
+				lengthValue = DecodeLength(
+					rc,
+					model->length,
+					posState);
+
+				uint32_t distance = DecodeDistance(
+					rc,
+					*model,
+					lengthValue);
+
+				reps.Push(distance + 1);
+			}
+
+			size_t length = lengthValue + MIN_MATCH;
+			uint32_t offset = reps.offsets[0];
+
+			if (offset == 0
+				|| offset > outPos
+				|| length > end - outPos)
+			{
+				outError = "Invalid match at position '" + to_string(outPos) + "' in '" + origin + "' (corruption suspected)!\n";
+				return {};
+			}
+
+			CopyMatch(
+				dst + outPos,
+				offset,
+				length);
+
+			outPos += length;
+			state = ((state << 1) | 1) & (STATE_COUNT - 1);
+		}
+
+		if (rc.pos > size)
+		{
+			outError = "Unexpected end of data while range decoding '" + origin + "'!\n";
+			return {};
+		}
+
+		out.resize(end);
+		if (start > 0) out.erase(out.begin(), out.begin() + start);
+
+		return out;
+	}
+}
+
+void EncodeTree(
+	RangeEncoder& rc,
+	Prob* probs,
+	uint32_t bits,
+	uint32_t value)
+{
+	uint32_t m = 1;
+
+	while (bits-- > 0)
+	{
+		uint32_t bit = (value >> bits) & 1;
+		rc.EncodeBit(probs[m], bit);
+		m = (m << 1) | bit;
+	}
+}
+
+uint32_t DecodeTree(
+	RangeDecoder& rc,
+	Prob* probs,
+	uint32_t bits)
+{
+	uint32_t m = 1;
+
+	for (uint32_t i = 0; i < bits; i++)
+	{
+		m = (m << 1) | rc.DecodeBit(probs[m]);
+	}
+
+	return m - (1u << bits);
+}
+
+void EncodeReverseTree(
+	RangeEncoder& rc,
+	Prob* probs,
+	uint32_t bits,
+	uint32_t value)
+{
+	uint32_t m = 1;
+
+	for (uint32_t i = 0; i < bits; i++)
+	{
+		uint32_t bit = value & 1;
+		value >>= 1;
+		rc.EncodeBit(probs[m], bit);
+		m = (m << 1) | bit;
+	}
+}
+
+uint32_t DecodeReverseTree(
+	RangeDecoder& rc,
+	Prob* probs,
+	uint32_t bits)
+{
+	uint32_t m = 1;
+	uint32_t value = 0;
+
+	for (uint32_t i = 0; i < bits; i++)
+	{
+		uint32_t bit = rc.DecodeBit(probs[m]);
+		m = (m << 1) | bit;
+		value |= bit << i;
+	}
+
+	return value;
+}
+
+void EncodeLiteral(
+	RangeEncoder& rc,
+	Prob* probs,
+	uint32_t symbol,
+	bool matched,
+	uint32_t matchByte)
+{
+	uint32_t m = 1;
+
+	for (int i = 7; i >= 0; i--)
+	{
+		uint32_t bit = (symbol >> i) & 1;
+
+		if (matched)
+		{
+			uint32_t matchBit = (matchByte >> i) & 1;
+			rc.EncodeBit(probs[0x100 + (matchBit << 8) + m], bit);
+			matched = bit == matchBit;
+		}
+		else
+		{
+			rc.EncodeBit(probs[m], bit);
+		}
+
+		m = (m << 1) | bit;
+	}
+}
+
+uint8_t DecodeLiteral(
+	RangeDecoder& rc,
+	Prob* probs,
+	bool matched,
+	uint32_t matchByte)
+{
+	uint32_t m = 1;
+
+	for (int i = 7; i >= 0; i--)
+	{
+		uint32_t bit{};
+
+		if (matched)
+		{
+			uint32_t matchBit = (matchByte >> i) & 1;
+			bit = rc.DecodeBit(probs[0x100 + (matchBit << 8) + m]);
+			matched = bit == matchBit;
+		}
+		else
+		{
+			bit = rc.DecodeBit(probs[m]);
+		}
+
+		m = (m << 1) | bit;
+	}
+
+	return static_cast<uint8_t>(m);
+}
+
+void EncodeLength(
+	RangeEncoder& rc,
+	LengthModel& model,
+	uint32_t value,
+	size_t posState)
+{
+	if (value < LENGTH_LOW_COUNT)
+	{
+		rc.EncodeBit(model.choice, 0);
+		EncodeTree(rc, model.low[posState], LENGTH_LOW_BITS, value);
+		return;
+	}
+
+	rc.EncodeBit(model.choice, 1);
+	value -= LENGTH_LOW_COUNT;
+
+	if (value < LENGTH_MID_COUNT)
+	{
+		rc.EncodeBit(model.choice2, 0);
+		EncodeTree(rc, model.mid[posState], LENGTH_MID_BITS, value);
+		return;
+	}
+
+	rc.EncodeBit(model.choice2, 1);
+	value -= LENGTH_MID_COUNT;
+
+	if (value < LENGTH_HIGH_ESCAPE)
+	{
+		EncodeTree(rc, model.high, LENGTH_HIGH_BITS, value);
+		return;
+	}
+
+	EncodeTree(rc, model.high, LENGTH_HIGH_BITS, LENGTH_HIGH_ESCAPE);
+	rc.EncodeDirect(value - LENGTH_HIGH_ESCAPE, LENGTH_ESCAPE_BITS);
+}
+
+uint32_t DecodeLength(
+	RangeDecoder& rc,
+	LengthModel& model,
+	size_t posState)
+{
+	if (rc.DecodeBit(model.choice) == 0)
+	{
+		return DecodeTree(rc, model.low[posState], LENGTH_LOW_BITS);
+	}
+
+	if (rc.DecodeBit(model.choice2) == 0)
+	{
+		return LENGTH_LOW_COUNT
+			+ DecodeTree(rc, model.mid[posState], LENGTH_MID_BITS);
+	}
+
+	uint32_t value = DecodeTree(rc, model.high, LENGTH_HIGH_BITS);
+	if (value == LENGTH_HIGH_ESCAPE) value += rc.DecodeDirect(LENGTH_ESCAPE_BITS);
+
+	return LENGTH_LOW_COUNT
+		+ LENGTH_MID_COUNT
+		+ value;
+}
+
+void EncodeDistance(
+	RangeEncoder& rc,
+	TokenModel& model,
+	uint32_t distance,
+	uint32_t lengthValue)
+{
+	size_t lengthState = min<size_t>(lengthValue, LENGTH_STATE_COUNT - 1);
+
+	uint32_t slot = OffsetSlot(distance);
+
+	EncodeTree(rc, model.slot[lengthState], SLOT_BITS, slot);
+
+	if (slot < 4) return;
+
+	uint32_t extraBits = OffsetExtraBits(slot);
+	uint32_t base = OffsetBase(slot);
+	uint32_t extra = distance - base;
+
+	if (slot < END_MODELLED_SLOT)
+	{
+		EncodeReverseTree(rc, model.modelled + base - slot, extraBits, extra);
+		return;
+	}
+
+	rc.EncodeDirect(extra >> ALIGN_BITS, extraBits - ALIGN_BITS);
+	EncodeReverseTree(rc, model.align, ALIGN_BITS, extra & ((1u << ALIGN_BITS) - 1));
+}
+
+uint32_t DecodeDistance(
+	RangeDecoder& rc,
+	TokenModel& model,
+	uint32_t lengthValue)
+{
+	size_t lengthState = min<size_t>(lengthValue, LENGTH_STATE_COUNT - 1);
+
+	uint32_t slot = DecodeTree(rc, model.slot[lengthState], SLOT_BITS);
+
+	if (slot < 4) return slot;
+
+	uint32_t extraBits = OffsetExtraBits(slot);
+	uint32_t base = OffsetBase(slot);
+
+	if (slot < END_MODELLED_SLOT)
+	{
+		return base + DecodeReverseTree(rc, model.modelled + base - slot, extraBits);
+	}
+
+	uint32_t extra = rc.DecodeDirect(extraBits - ALIGN_BITS) << ALIGN_BITS;
+	return base + extra + DecodeReverseTree(rc, model.align, ALIGN_BITS);
+}
\ No newline at end of file
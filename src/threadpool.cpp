@@ -0,0 +1,140 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#include <algorithm>
+
+#include "threadpool.hpp"
+
+using KalaData::ThreadPool;
+using KalaData::MAX_THREAD_COUNT;
+
+using std::make_unique;
+using std::lock_guard;
+using std::unique_lock;
+using std::move;
+using std::clamp;
+using std::max;
+
+//pool and queue of the worker running on this thread, unset on other threads
+static thread_local const ThreadPool* currentPool{};
+static thread_local size_t currentQueue = SIZE_MAX;
+
+namespace KalaData
+{
+	ThreadPool::ThreadPool(size_t threadCount)
+	{
+		threadCount = clamp(threadCount, static_cast<size_t>(1), MAX_THREAD_COUNT);
+
+		for (size_t i = 0; i < threadCount; i++)
+		{
+			queues.push_back(make_unique<TaskQueue>());
+		}
+
+		for (size_t i = 0; i < threadCount; i++)
+		{
+			workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			lock_guard<mutex> guard(sleepLock);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::Submit(function<void()> task)
+	{
+		size_t index = GetWorkerIndex();
+		if (index == SIZE_MAX) index = nextQueue++ % queues.size();
+
+		//counted before the task is queued, so a worker that takes it right away never
+		//lowers pending below zero. Raised under the sleep lock so a worker can't miss it
+		//between its check and its wait
+		{
+			lock_guard<mutex> guard(sleepLock);
+			pending++;
+		}
+
+		{
+			lock_guard<mutex> guard(queues[index]->lock);
+			queues[index]->tasks.push_back(move(task));
+		}
+		wake.notify_one();
+	}
+
+	size_t ThreadPool::GetWorkerIndex() const
+	{
+		return currentPool == this
+			? currentQueue
+			: SIZE_MAX;
+	}
+
+	size_t ThreadPool::ResolveThreadCount(size_t threadCount)
+	{
+		if (threadCount == 0) threadCount = max(thread::hardware_concurrency(), 1u);
+
+		return clamp(threadCount, static_cast<size_t>(1), MAX_THREAD_COUNT);
+	}
+
+	void ThreadPool::WorkerLoop(size_t index)
+	{
+		currentPool = this;
+		currentQueue = index;
+
+		function<void()> task{};
+
+		while (true)
+		{
+			if (TakeTask(index, task))
+			{
+				task();
+				task = nullptr;
+
+				continue;
+			}
+
+			unique_lock<mutex> guard(sleepLock);
+			wake.wait(guard, [this] { return pending > 0 || stopping; });
+
+			//queued tasks still run after the pool starts stopping
+			if (stopping
+				&& pending == 0)
+			{
+				return;
+			}
+		}
+	}
+
+	bool ThreadPool::TakeTask(
+		size_t index,
+		function<void()>& outTask)
+	{
+		//own queue first, then the next queue that has a task
+		for (size_t i = 0; i < queues.size(); i++)
+		{
+			TaskQueue& queue = *queues[(index + i) % queues.size()];
+			lock_guard<mutex> guard(queue.lock);
+
+			if (!queue.tasks.empty())
+			{
+				outTask = move(queue.tasks.front());
+				queue.tasks.pop_front();
+				pending--;
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,460 @@
+//Copyright(C) 2025 Lost Empire Entertainment
+//This program comes with ABSOLUTELY NO WARRANTY.
+//This is free software, and you are welcome to redistribute it under certain conditions.
+//Read LICENSE.md for more information.
+
+#include <algorithm>
+#include <cstring>
+#include <bit>
+
+#include "tokenstreams.hpp"
+#include "huffman.hpp"
+#include "fse.hpp"
+#include "bitstream.hpp"
+#include "blockreader.hpp"
+#include "compress.hpp"
+
+using KalaData::TokenStreams;
+using KalaData::Huffman;
+using KalaData::Fse;
+using KalaData::BitReader;
+using KalaData::BitWriter;
+using KalaData::ReadVarint;
+using KalaData::WriteVarint;
+using KalaData::OffsetSlot;
+using KalaData::OffsetExtraBits;
+using KalaData::OffsetBase;
+using KalaData::OFFSET_SLOT_COUNT;
+using KalaData::RepHistory;
+using KalaData::REP_COUNT;
+using KalaData::MIN_MATCH;
+using KalaData::Token;
+using KalaData::TokenReader;
+using KalaData::LENGTH_ESCAPE;
+using KalaData::LENGTH_ESCAPE_BITS;
+using KalaData::WILDCOPY_OVERLENGTH;
+using KalaData::BlockReader;
+using KalaData::StreamCoder;
+using KalaData::CopyMatch;
+
+using std::vector;
+using std::string;
+using std::to_string;
+
+using std::move;
+using std::memcpy;
+using std::min;
+using std::countr_one;
+
+//Where a stream is stored and how many symbols it decodes to
+struct StreamHeader
+{
+	StreamCoder coder;
+	size_t count;
+	const uint8_t* data;
+	size_t size;
+};
+
+//Stream order inside the coded data
+enum StreamIndex
+{
+	STREAM_FLAGS,
+	STREAM_LITERALS,
+	STREAM_LENGTHS,
+	STREAM_SLOTS,
+	STREAM_EXTRA,
+	STREAM_COUNT
+};
+
+//Appends the coder, decoded size, stored size and data of one stream,
+//byte streams are stored with whichever coder is smallest
+static void WriteStream(
+	const vector<uint8_t>& stream,
+	bool entropyCoded,
+	vector<uint8_t>& output,
+	const string& origin);
+
+//Reads the header of the stream at pos and moves pos past its data, false if it is damaged
+static bool ReadStreamHeader(
+	const uint8_t* data,
+	size_t size,
+	size_t& pos,
+	StreamHeader& outHeader,
+	const string& origin,
+	string& outError);
+
+namespace KalaData
+{
+	vector<uint8_t> TokenStreams::Encode(
+		const vector<uint8_t>& lzssStream,
+		const string& origin)
+	{
+		vector<uint8_t> streams[STREAM_COUNT]{};
+		streams[STREAM_FLAGS].reserve(lzssStream.size() / 16);
+		streams[STREAM_LITERALS].reserve(lzssStream.size() / 2);
+
+		//the extra bits of a match never take more bytes than its offset
+		//and length do in lzssStream, the spare 8 bytes absorb the last whole-word flush
+		vector<uint8_t>& extra = streams[STREAM_EXTRA];
+		extra.resize(lzssStream.size() + 8);
+		BitWriter writer{ extra.data() };
+
+		TokenReader reader{ lzssStream };
+		Token token{};
+		RepHistory reps{};
+		size_t tokenCount = 0;
+
+		while (reader.Next(token))
+		{
+			//8 flags per byte, lowest bit first
+			if ((tokenCount & 7) == 0) streams[STREAM_FLAGS].push_back(0);
+			if (token.isLiteral) streams[STREAM_FLAGS].back() |= static_cast<uint8_t>(1u << (tokenCount & 7));
+			tokenCount++;
+
+			if (token.isLiteral)
+			{
+				streams[STREAM_LITERALS].push_back(token.literal);
+				continue;
+			}
+
+			uint32_t lengthValue = token.length - MIN_MATCH;
+			if (lengthValue < LENGTH_ESCAPE)
+			{
+				streams[STREAM_LENGTHS].push_back(static_cast<uint8_t>(lengthValue));
+			}
+			else
+			{
+				streams[STREAM_LENGTHS].push_back(static_cast<uint8_t>(LENGTH_ESCAPE));
+				writer.Put(lengthValue - LENGTH_ESCAPE, LENGTH_ESCAPE_BITS);
+				writer.Flush();
+			}
+
+			uint32_t repIndex = reps.Update(token.offset);
+			if (repIndex < REP_COUNT)
+			{
+				streams[STREAM_SLOTS].push_back(static_cast<uint8_t>(OFFSET_SLOT_COUNT + repIndex));
+				continue;
+			}
+
+			uint32_t distance = token.offset - 1;
+			uint32_t slot = OffsetSlot(distance);
+			streams[STREAM_SLOTS].push_back(static_cast<uint8_t>(slot));
+
+			uint32_t extraBits = OffsetExtraBits(slot);
+			if (extraBits > 0)
+			{
+				writer.Put(distance - OffsetBase(slot), extraBits);
+				writer.Flush();
+			}
+		}
+
+		extra.resize((writer.dst - extra.data()) + (writer.bitCount > 0 ? 1 : 0));
+
+		vector<uint8_t> output{};
+
+		for (size_t i = 0; i < STREAM_COUNT; i++)
+		{
+			WriteStream(
+				streams[i],
+				i != STREAM_EXTRA,
+				output,
+				origin);
+		}
+
+		return output;
+	}
+
+	vector<uint8_t> TokenStreams::Decode(
+		const uint8_t* data,
+		size_t size,
+		size_t originalSize,
+		const vector<uint8_t>& dictionary,
+		const string& origin,
+		string& outError)
+	{
+		StreamHeader headers[STREAM_COUNT]{};
+		size_t pos = 0;
+
+		for (size_t i = 0; i < STREAM_COUNT; i++)
+		{
+			if (!ReadStreamHeader(
+				data,
+				size,
+				pos,
+				headers[i],
+				origin,
+				outError))
+			{
+				return {};
+			}
+		}
+
+		const StreamHeader& extra = headers[STREAM_EXTRA];
+
+		size_t literalCount = headers[STREAM_LITERALS].count;
+		size_t matchCount = headers[STREAM_LENGTHS].count;
+		size_t flagCount = headers[STREAM_FLAGS].count;
+		size_t tokenCount = literalCount + matchCount;
+
+		if (matchCount != headers[STREAM_SLOTS].count
+			|| tokenCount < literalCount
+			|| flagCount != tokenCount / 8 + ((tokenCount & 7) != 0 ? 1 : 0)
+			|| extra.coder != StreamCoder::STREAM_RAW)
+		{
+			outError = "Token stream sizes do not agree in '" + origin + "' (corruption suspected)!\n";
+			return {};
+		}
+
+		//the byte streams are decoded block by block while the tokens run,
+		//only the extra bits are read in place as one bitstream. A damaged
+		//block leaves its own error, which the checks below keep
+		BlockReader flags(headers[STREAM_FLAGS].coder, headers[STREAM_FLAGS].data, headers[STREAM_FLAGS].size, origin, outError);
+		BlockReader literals(headers[STREAM_LITERALS].coder, headers[STREAM_LITERALS].data, headers[STREAM_LITERALS].size, origin, outError);
+		BlockReader lengths(headers[STREAM_LENGTHS].coder, headers[STREAM_LENGTHS].data, headers[STREAM_LENGTHS].size, origin, outError);
+		BlockReader slots(headers[STREAM_SLOTS].coder, headers[STREAM_SLOTS].data, headers[STREAM_SLOTS].size, origin, outError);
+
+		//the dictionary is decoded in front of the data and dropped afterwards
+		size_t start = dictionary.size();
+		size_t end = start + originalSize;
+
+		vector<uint8_t> out(end + WILDCOPY_OVERLENGTH);
+		uint8_t* dst = out.data();
+		if (start > 0) memcpy(dst, dictionary.data(), start);
+
+		BitReader reader{ extra.data, extra.size, 0 };
+		RepHistory reps{};
+
+		size_t outPos = start;
+		size_t literal = 0;
+		size_t match = 0;
+
+		uint64_t flagBits = 0;
+
+		for (size_t t = 0; t < tokenCount; t++)
+		{
+			//flags are loaded 64 tokens at a time so literal runs can span flag bytes
+			if ((t & 63) == 0)
+			{
+				flagBits = 0;
+				size_t flagBytes = min(flagCount - (t >> 3), static_cast<size_t>(8));
+				for (size_t i = 0; i < flagBytes; i++)
+				{
+					uint8_t flagByte{};
+					if (!flags.Read(flagByte))
+					{
+						if (outError.empty()) outError = "Flags past the end of their stream in '" + origin + "' (corruption suspected)!\n";
+						return {};
+					}
+
+					flagBits |= static_cast<uint64_t>(flagByte) << (i * 8);
+				}
+			}
+
+			if ((flagBits & 1) != 0)
+			{
+				//the run of literal flags left in this word is copied at once
+				size_t run = min(
+					static_cast<size_t>(countr_one(flagBits)),
+					tokenCount - t);
+
+				if (run > end - outPos
+					|| run > literalCount - literal)
+				{
+					outError = "Literal past the end of its stream in '" + origin + "' (corruption suspected)!\n";
+					return {};
+				}
+
+				literal += run;
+				flagBits = run < 64 ? flagBits >> run : 0;
+				t += run - 1;
+
+				//runs may continue in the next block of the literal stream
+				while (run > 0)
+				{
+					if (literals.next == literals.end
+						&& !literals.Refill())
+					{
+						if (outError.empty()) outError = "Literal past the end of its stream in '" + origin + "' (corruption suspected)!\n";
+						return {};
+					}
+
+					size_t chunk = min(run, static_cast<size_t>(literals.end - literals.next));
+					if (static_cast<size_t>(literals.limit - literals.next) >= chunk + 16)
+					{
+						for (size_t i = 0; i < chunk; i += 16) memcpy(dst + outPos + i, literals.next + i, 16);
+					}
+					else memcpy(dst + outPos, literals.next, chunk);
+
+					outPos += chunk;
+					literals.next += chunk;
+					run -= chunk;
+				}
+
+				continue;
+			}
+
+			flagBits >>= 1;
+
+			uint8_t lengthByte{};
+			uint8_t slotByte{};
+
+			if (match == matchCount
+				|| !lengths.Read(lengthByte)
+				|| !slots.Read(slotByte))
+			{
+				if (outError.empty()) outError = "Match past the end of its stream in '" + origin + "' (corruption suspected)!\n";
+				return {};
+			}
+
+			size_t lengthValue = lengthByte;
+			uint32_t slot = slotByte;
+			match++;
+
+			//one refill covers the length escape and the offset extra bits
+			reader.Refill();
+			if (lengthValue == LENGTH_ESCAPE) lengthValue += reader.Read(LENGTH_ESCAPE_BITS);
+
+			size_t length = lengthValue + MIN_MATCH;
+
+			uint64_t offset{};
+
+			if (slot < OFFSET_SLOT_COUNT)
+			{
+				offset = static_cast<uint64_t>(OffsetBase(slot))
+					+ reader.Read(OffsetExtraBits(slot))
+					+ 1;
+
+				reps.Push(static_cast<uint32_t>(offset));
+			}
+			else if (slot < OFFSET_SLOT_COUNT + REP_COUNT)
+			{
+				offset = reps.offsets[slot - OFFSET_SLOT_COUNT];
+				reps.Use(slot - OFFSET_SLOT_COUNT);
+			}
+			else
+			{
+				outError = "Invalid offset slot '" + to_string(slot) + "' in '" + origin + "' (corruption suspected)!\n";
+				return {};
+			}
+
+			if (offset == 0
+				|| offset > outPos
+				|| length > end - outPos)
+			{
+				outError = "Invalid match at position '" + to_string(outPos) + "' in '" + origin + "' (corruption suspected)!\n";
+				return {};
+			}
+
+			CopyMatch(
+				dst + outPos,
+				offset,
+				length);
+
+			outPos += length;
+		}
+
+		if (outPos != end
+			|| reader.Consumed(0) > extra.size * 8
+			|| !flags.IsFinished()
+			|| !literals.IsFinished()
+			|| !lengths.IsFinished()
+			|| !slots.IsFinished())
+		{
+			outError = "Tokens do not decode to the original size of '" + origin + "' (corruption suspected)!\n";
+			return {};
+		}
+
+		out.resize(end);
+		if (start > 0) out.erase(out.begin(), out.begin() + start);
+
+		return out;
+	}
+}
+
+void WriteStream(
+	const vector<uint8_t>& stream,
+	bool entropyCoded,
+	vector<uint8_t>& output,
+	const string& origin)
+{
+	StreamCoder coder = StreamCoder::STREAM_RAW;
+	vector<uint8_t> coded{};
+
+	if (entropyCoded
+		&& !stream.empty())
+	{
+		coded = Huffman::Encode(stream, origin);
+		coder = StreamCoder::STREAM_HUFFMAN;
+
+		vector<uint8_t> fseData = Fse::Encode(stream, origin);
+		if (!fseData.empty()
+			&& fseData.size() < coded.size())
+		{
+			coded = move(fseData);
+			coder = StreamCoder::STREAM_FSE;
+		}
+
+		if (coded.size() >= stream.size()) coder = StreamCoder::STREAM_RAW;
+	}
+
+	const vector<uint8_t>& stored = coder == StreamCoder::STREAM_RAW
+		? stream
+		: coded;
+
+	output.push_back(static_cast<uint8_t>(coder));
+	WriteVarint(output, stream.size());
+	WriteVarint(output, stored.size());
+	output.insert(output.end(), stored.begin(), stored.end());
+}
+
+bool ReadStreamHeader(
+	const uint8_t* data,
+	size_t size,
+	size_t& pos,
+	StreamHeader& outHeader,
+	const string& origin,
+	string& outError)
+{
+	uint64_t count{};
+	uint64_t storedSize{};
+
+	if (pos >= size)
+	{
+		outError = "Unexpected end of data while reading token streams in '" + origin + "'!\n";
+		return false;
+	}
+
+	uint8_t coder = data[pos++];
+
+	if (!ReadVarint(data, size, pos, count)
+		|| !ReadVarint(data, size, pos, storedSize)
+		|| storedSize > size - pos)
+	{
+		outError = "Unexpected end of data while reading token streams in '" + origin + "'!\n";
+		return false;
+	}
+
+	if (coder > static_cast<uint8_t>(StreamCoder::STREAM_FSE))
+	{
+		outError = "Unknown stream coder '" + to_string(coder) + "' in '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	//raw streams are stored as they are
+	if (coder == static_cast<uint8_t>(StreamCoder::STREAM_RAW)
+		&& count != storedSize)
+	{
+		outError = "Decoded stream size does not match its header in '" + origin + "' (corruption suspected)!\n";
+		return false;
+	}
+
+	outHeader = {
+		static_cast<StreamCoder>(coder),
+		static_cast<size_t>(count),
+		data + pos,
+		static_cast<size_t>(storedSize) };
+
+	pos += static_cast<size_t>(storedSize);
+
+	return true;
+}
\ No newline at end of file